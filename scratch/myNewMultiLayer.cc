@@ -18,6 +18,7 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <map>
 #include <memory>
 #include <string>
 #include "ns3/core-module.h"
@@ -33,6 +34,8 @@
 
 #include "ns3/my-tree.h"
 #include "ns3/my-orchestrator.h"
+#include "ns3/my-tree-routing.h"
+#include "ns3/mpi-interface.h"
 
 using namespace ns3;
 
@@ -85,6 +88,38 @@ main(int argc, char *argv[])
   std::string place = "0-0-0-0";
   std::string path="/root/result";
   uint32_t makespan = 200000;
+  uint32_t aggregate = 1;
+  double aggRatio = 1.0;
+  uint32_t cache = 0;
+  uint32_t keys = 0;
+  uint32_t offload = 0;
+  uint32_t steal = 0;
+  uint32_t migrate = 0;
+  uint32_t state = 1000000;
+  uint32_t search = 0;
+  bool report = false;
+  bool metrics = false;
+  uint32_t binary = 0;
+  bool traceAll = false;
+  std::string routing = "global";
+  std::string topologyFile = "";
+  bool mpi = false;
+  double sample = 1.0;
+  bool aggregateLeaves = false;
+  std::string linkMode = "p2p";
+  std::string nodeList = "csv";
+  uint32_t outstanding = 0;
+  uint32_t thinkTime = 0;
+  std::string trace = "";
+  std::string arrival = "offtime";
+  std::string mmppMeans = "1000000-100000";
+  std::string mmppDwell = "10000000-1000000";
+  uint32_t paretoSources = 10;
+  double paretoShape = 1.5;
+  uint32_t burstInterval = 0;
+  double burstSize = 1;
+  uint32_t requestSize = 0;
+  std::string outputRatio = "1-1-1-1";
 
   CommandLine cmd;
   cmd.AddValue ("node", "the number of nodes of each layer (\"Cloud Server ... Router ... GW\") (ex. \"1-2-10\")", nodeNum);
@@ -93,6 +128,38 @@ main(int argc, char *argv[])
   cmd.AddValue ("place", "server place (ex. 0-0-0-0)", place);
   cmd.AddValue ("path", "path of trace file (ex. /root/result)", path);
   cmd.AddValue ("makespan", "interval of paket send(ex. 200000)", makespan);
+  cmd.AddValue ("aggregate", "the number of requests merged by the first service (ex. 10)", aggregate);
+  cmd.AddValue ("aggRatio", "size of the merged message relative to the merged requests (ex. 0.1)", aggRatio);
+  cmd.AddValue ("cache", "the number of results cached by the first service (ex. 100)", cache);
+  cmd.AddValue ("offload", "queue length from which the first service offloads jobs to its siblings and parent, 0 disables (ex. 10)", offload);
+  cmd.AddValue ("steal", "reported load of a sibling from which an idle first service steals its jobs, 0 disables (ex. 2)", steal);
+  cmd.AddValue ("migrate", "interval [ms] at which the placement of every service is re-evaluated, 0 disables (ex. 5000)", migrate);
+  cmd.AddValue ("state", "bytes of state moved with a migrated service (ex. 1000000)", state);
+  cmd.AddValue ("search", "predict the latency of every placement, 1: report only, 2: use the best placement (ex. 2)", search);
+  cmd.AddValue ("report", "write the predicted and simulated mean latency to myLatency.csv", report);
+  cmd.AddValue ("metrics", "write latency percentiles, throughput and queue summaries to myMetrics.txt instead of per-packet CSV files", metrics);
+  cmd.AddValue ("binary", "write traces to myTrace.bin, 1: buffered, 2: buffered on a writer thread", binary);
+  cmd.AddValue ("traceAll", "trace every group instead of group 0, aggregated per layer and group (implies --metrics without --binary)", traceAll);
+  cmd.AddValue ("sample", "fraction of the requests whose latencies are kept by --metrics (ex. 0.01)", sample);
+  cmd.AddValue ("topologyFile", "read an irregular tree from a file instead of --node, --net and --delay (see PointToPointTreeHelper)", topologyFile);
+  cmd.AddValue ("mpi", "run the subtrees on the ranks of mpirun with the distributed simulator (ex. mpirun -np 4 ... --mpi=1)", mpi);
+  cmd.AddValue ("routing", "routing of the tree, \"global\": shortest paths of every node, \"tree\": a default route and a prefix per subtree", routing);
+  cmd.AddValue ("aggregateLeaves", "one source on the first leaf of each group sends the requests of the whole group, on an uplink scaled by the group size", aggregateLeaves);
+  cmd.AddValue ("linkMode", "links of the leaves, \"p2p\", \"p2p-no-tc\": without queue discs, \"csma\": a shared channel per group; the memory is written to myMemory.txt", linkMode);
+  cmd.AddValue ("nodeList", "format of the links written to <path>/myNodeList, \"csv\", \"json\", \"binary\" or \"none\"", nodeList);
+  cmd.AddValue ("outstanding", "requests in flight of a closed-loop client, 0 sends every makespan regardless of responses (ex. 1)", outstanding);
+  cmd.AddValue ("thinkTime", "mean of the exponential time [us] between a response and the next request in closed loop (ex. 100000)", thinkTime);
+  cmd.AddValue ("trace", "file of \"time[ns] client size [key]\" rows to replay instead of makespan, client c is the leaf c modulo the number of leaves", trace);
+  cmd.AddValue ("arrival", "arrival process of the clients, \"offtime\": exponential with mean makespan, \"mmpp\": Markov-modulated Poisson, \"pareto\": superposed Pareto on/off sources with the mean rate of makespan", arrival);
+  cmd.AddValue ("mmppMeans", "mean time [us] between requests in each state of --arrival=mmpp, 0 for a silent state (ex. 1000000-100000)", mmppMeans);
+  cmd.AddValue ("mmppDwell", "mean time [us] in each state of --arrival=mmpp (ex. 10000000-1000000)", mmppDwell);
+  cmd.AddValue ("paretoSources", "on/off sources per client of --arrival=pareto (ex. 10)", paretoSources);
+  cmd.AddValue ("paretoShape", "shape of the on and off periods of --arrival=pareto, in (1,2) for self-similar traffic (ex. 1.5)", paretoShape);
+  cmd.AddValue ("burstInterval", "mean time [us] between the bursts where all leaves of a group send together, 0 disables (ex. 5000000)", burstInterval);
+  cmd.AddValue ("burstSize", "mean number of requests of every leaf in a burst (ex. 10)", burstSize);
+  cmd.AddValue ("requestSize", "mean of the exponential size [bytes] of a request, 0 for the packet size (ex. 2000)", requestSize);
+  cmd.AddValue ("outputRatio", "size of the output of each service relative to its input, the last one is the response (ex. 0.1-1-1-1)", outputRatio);
+  cmd.AddValue ("keys", "the number of Zipf distributed request keys, 0 sends no key (ex. 1000)", keys);
   cmd.Parse(argc, argv);
 
   const std::vector<int> NODE_NUM = stringSplitToInt(nodeNum, '-');
@@ -117,18 +184,72 @@ main(int argc, char *argv[])
   Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue(13107200));
   Config::SetDefault ("ns3::QueueBase::MaxSize", StringValue ("100000000p"));
 
-  PointToPointTreeHelper p2ptree(NODE_NUM,BANDS,DELAYS);
+  uint32_t nSystems = 1;
+  if(mpi){
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+    MpiInterface::Enable(&argc, &argv);
+    nSystems = MpiInterface::GetSize();
+  }
+
+  PointToPointTreeHelper p2ptree = topologyFile.empty() ? PointToPointTreeHelper(NODE_NUM,BANDS,DELAYS,nSystems)
+                                                        : PointToPointTreeHelper(topologyFile,nSystems);
+
+  if(aggregateLeaves){
+    // the first leaf of each group carries the load of the group
+    uint32_t leaf = p2ptree.GetNLayers()-1;
+    for(uint32_t i=0;i<p2ptree.GetNGroups(leaf);i++){
+      // an empty group has no first leaf, its id is the one of the next group
+      if(p2ptree.GetNNodes(leaf,i)==0){
+        continue;
+      }
+      uint32_t id = p2ptree.GetNodeId(leaf,i,0);
+      std::stringstream bw;
+      bw << p2ptree.GetLinkDataRate(id).GetBitRate()*p2ptree.GetNNodes(leaf,i) << "bps";
+      std::stringstream delay;
+      delay << p2ptree.GetLinkDelay(id).GetNanoSeconds() << "ns";
+      p2ptree.SetLinkAttributes(id, bw.str(), delay.str());
+    }
+  }
+
+  if(linkMode=="p2p-no-tc"){
+    p2ptree.SetAccessLinkMode(PointToPointTreeHelper::LINK_P2P_NO_TC);
+  }
+  else if(linkMode=="csma"){
+    p2ptree.SetAccessLinkMode(PointToPointTreeHelper::LINK_CSMA_SHARED);
+  }
+  else if(linkMode!="p2p"){
+    NS_FATAL_ERROR("unknown link mode "<<linkMode);
+  }
 
   InternetStackHelper internet;
   internet.SetIpv6StackInstall(false);
   p2ptree.InstallStack(internet);
 
-  Ipv4AddressHelper address;
-  address.SetBase("10.0.1.0", "255.255.255.252");
-
-  p2ptree.AssignIpv4Addresses(address);
+  if(routing=="tree" || linkMode=="csma"){
+    // a shared channel needs a subnet per group
+    p2ptree.AssignIpv4Addresses(Ipv4Address("10.0.0.0"), Ipv4Mask("255.0.0.0"));
+  }
+  else{
+    Ipv4AddressHelper address;
+    address.SetBase("10.0.1.0", "255.255.255.252");
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    p2ptree.AssignIpv4Addresses(address);
+  }
+  if(nodeList!="none" && (!mpi || MpiInterface::GetSystemId()==0)){
+    // format and file extension
+    std::map<std::string, std::pair<PointToPointTreeHelper::TopologyFormat, std::string>> formats{
+      {"csv", {PointToPointTreeHelper::TOPOLOGY_CSV, ".csv"}},
+      {"json", {PointToPointTreeHelper::TOPOLOGY_JSON, ".json"}},
+      {"binary", {PointToPointTreeHelper::TOPOLOGY_BINARY, ".bin"}}};
+    NS_ABORT_MSG_IF(!formats.count(nodeList), "unknown node list format "<<nodeList);
+    p2ptree.ExportTopology(path+"/myNodeList"+formats[nodeList].second, formats[nodeList].first);
+  }
+  if(routing=="tree"){
+    PointToPointTreeRoutingHelper::PopulateRoutingTables(p2ptree);
+  }
+  else{
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+  }
 
   MyOrchestrator orch(p2ptree);
   orch.SetSimulationTime(SIM_TIME);
@@ -151,13 +272,103 @@ main(int argc, char *argv[])
   orch.CreateChaine(first, second);
   orch.CreateChaine(second, third);
   orch.CreateChaine(third, fourth);
+  orch.SetAggregation(first, aggregate, MilliSeconds(100), aggRatio);
+  std::vector<uint8_t> services{first, second, third, fourth};
+  std::vector<std::string> ratios = stringSplit(outputRatio, '-');
+  for(size_t i=0; i<services.size() && i<ratios.size(); i++){
+    orch.SetOutputRatio(services[i], std::atof(ratios[i].c_str()));
+  }
+  if(offload>0){
+    orch.SetOffload(first, offload, Seconds(0), true);
+  }
+  if(steal>0){
+    orch.SetStealing(first, steal, MilliSeconds(10), MyTcpServer::STEAL_RANDOM);
+  }
+  orch.SetCache(first, cache, MyResultCache::LRU, Seconds(0), MyTcpServer::CACHE_PAYLOAD);
+  if(keys>0){
+    std::stringstream key;
+    key<<"ns3::ZipfRandomVariable[N="<<keys<<"|Alpha=1.0]";
+    orch.SetClientKey(key.str());
+  }
+  if(outstanding>0){
+    std::stringstream think;
+    think<<"ns3::ExponentialRandomVariable[Mean="<<thinkTime<<"]";
+    orch.SetClientClosedLoop(outstanding, thinkTime>0 ? think.str() : "ns3::ConstantRandomVariable[Constant=0]");
+  }
+  if(!trace.empty()){
+    orch.SetClientTrace(trace);
+  }
+  if(arrival=="mmpp"){
+    orch.SetClientAttribute("Arrival", StringValue("Mmpp"));
+    orch.SetClientAttribute("MmppMeans", StringValue(mmppMeans));
+    orch.SetClientAttribute("MmppDwell", StringValue(mmppDwell));
+  }
+  else if(arrival=="pareto"){
+    // on a tenth of the time, so each source sends every makespan*paretoSources/10 while on
+    orch.SetClientAttribute("Arrival", StringValue("Pareto"));
+    orch.SetClientAttribute("ParetoSources", UintegerValue(paretoSources));
+    orch.SetClientAttribute("ParetoShape", DoubleValue(paretoShape));
+    orch.SetClientAttribute("ParetoOn", DoubleValue(1000000));
+    orch.SetClientAttribute("ParetoOff", DoubleValue(9000000));
+    orch.SetClientAttribute("ParetoInterval", DoubleValue(makespan*paretoSources/10.0));
+  }
+  else if(arrival!="offtime"){
+    NS_FATAL_ERROR("unknown arrival process "<<arrival);
+  }
+  if(burstInterval>0){
+    orch.SetClientAttribute("BurstInterval", DoubleValue(burstInterval));
+    orch.SetClientAttribute("BurstSize", DoubleValue(burstSize));
+  }
+  if(requestSize>0){
+    std::stringstream size;
+    size<<"ns3::ExponentialRandomVariable[Mean="<<requestSize<<"]";
+    orch.SetClientAttribute("RequestSize", StringValue(size.str()));
+  }
+  if(migrate>0){
+    for(uint32_t i=0; i<orch.GetCurrentNServer(); i++){
+      orch.EnableMigration(i, MilliSeconds(migrate), state, 0.2);
+    }
+  }
+  if(search>0){
+    orch.EnablePlacementSearch(search==2);
+  }
+  if(report){
+    orch.EnableLatencyReport();
+  }
+  if(metrics){
+    orch.EnableMetrics();
+  }
+  if(binary>0){
+    orch.EnableBinaryTrace(binary==2);
+  }
+  if(aggregateLeaves){
+    orch.EnableAggregateClients();
+  }
+  if(traceAll || sample<1){
+    orch.SetTraceCoverage(traceAll, sample);
+  }
   orch.SetPlace(PLACE);
   orch.SetPath(path);
   orch.Assign();
 
   Simulator::Stop(Seconds(SIM_TIME+10));
   Simulator::Run();
+
+  // after the run, so that the peak memory includes the simulation
+  {
+    std::stringstream file;
+    file << path << "/myMemory";
+    if(mpi){
+      file << "-" << MpiInterface::GetSystemId();
+    }
+    file << ".txt";
+    std::ofstream memory(file.str());
+    p2ptree.ReportMemory(memory);
+  }
   Simulator::Destroy();
+  if(mpi){
+    MpiInterface::Disable();
+  }
 
   return 0;
 }
@@ -0,0 +1,248 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Run a grid of myNewMultiLayer scenarios as a pool of local processes.
+//
+// ./waf --run "mySweep --place=all --makespan=100000,200000
+//   --topology=1-1-5-20/40Gbps-10Gbps-1Gbps/10ms-5ms-2ms --runs=3 --path=/root/sweep"
+//
+// Each run writes its traces to <path>/run-<n> and its summary line
+// is appended to <path>/mySweep.csv.
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "ns3/core-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MySweep");
+
+std::vector<std::string> stringSplit(const std::string &str, char sep)
+{
+  std::vector<std::string> v;
+  std::stringstream ss(str);
+  std::string buffer;
+  while(getline(ss, buffer, sep)) {
+    v.push_back(buffer);
+  }
+  return v;
+}
+
+struct Run
+{
+  uint32_t id;
+  std::string node;
+  std::string net;
+  std::string delay;
+  std::string makespan;
+  std::string place;
+  uint32_t rngRun;
+  std::string dir;
+};
+
+// every placement of nServers services on nLayers layers
+std::vector<std::string> allPlaces(uint32_t nLayers, uint32_t nServers)
+{
+  std::vector<std::string> places;
+  std::vector<uint32_t> place(nServers, 0);
+  while(true){
+    std::stringstream ss;
+    for(size_t j=0; j<nServers; j++){
+      ss << (j==0 ? "" : "-") << place[j];
+    }
+    places.push_back(ss.str());
+    size_t k = 0;
+    while(k<nServers && ++place[k]==nLayers){
+      place[k++] = 0;
+    }
+    if(k==nServers){
+      break;
+    }
+  }
+  return places;
+}
+
+pid_t startRun(const std::string& program, const Run& run)
+{
+  if(mkdir(run.dir.c_str(), 0755)==-1 && errno!=EEXIST){
+    NS_FATAL_ERROR("cannot create " << run.dir << ": " << std::strerror(errno));
+  }
+  std::vector<std::string> args{
+    program,
+    "--node="+run.node,
+    "--net="+run.net,
+    "--delay="+run.delay,
+    "--makespan="+run.makespan,
+    "--place="+run.place,
+    "--path="+run.dir,
+    "--report=1",
+    "--RngRun="+std::to_string(run.rngRun),
+  };
+  pid_t pid = fork();
+  if(pid==-1){
+    NS_FATAL_ERROR("fork failed: " << std::strerror(errno));
+  }
+  if(pid==0){
+    // files written to the working directory stay in the run directory
+    if(chdir(run.dir.c_str())==-1){
+      _exit(127);
+    }
+    int log = open("log.txt", O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(log!=-1){
+      dup2(log, STDOUT_FILENO);
+      dup2(log, STDERR_FILENO);
+      close(log);
+    }
+    std::vector<char*> argv;
+    for(auto& i: args){
+      argv.push_back(const_cast<char*>(i.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(program.c_str(), argv.data());
+    _exit(127);
+  }
+  return pid;
+}
+
+void writeResult(std::ofstream& ofs, const Run& run, int status)
+{
+  std::string latency = "- - - -";
+  std::ifstream ifs(run.dir+"/myLatency.csv");
+  std::string line;
+  if(std::getline(ifs, line) && std::getline(ifs, line)){
+    // drop the place column, which is already in the result
+    latency = line.substr(line.find(' ')+1);
+  }
+  ofs << run.id << " " << run.node << " " << run.net << " " << run.delay << " "
+      << run.makespan << " " << run.place << " " << run.rngRun << " "
+      << latency << " " << status << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  std::string topology = "1-1-5-20/40Gbps-10Gbps-1Gbps/10ms-5ms-2ms";
+  std::string place = "0-0-0-0";
+  std::string makespan = "200000";
+  std::string path = "/root/sweep";
+  std::string program;
+  uint32_t runs = 1;
+  uint32_t servers = 4;
+  uint32_t jobs = std::thread::hardware_concurrency();
+
+  CommandLine cmd;
+  cmd.AddValue ("topology", "comma separated topologies, each \"node/net/delay\" (ex. \"1-1-5-20/40Gbps-10Gbps-1Gbps/10ms-5ms-2ms\")", topology);
+  cmd.AddValue ("place", "comma separated server places, or \"all\" (ex. 0-0-0-0,1-1-1-1)", place);
+  cmd.AddValue ("makespan", "comma separated intervals of packet send (ex. 100000,200000)", makespan);
+  cmd.AddValue ("runs", "the number of independent runs of each scenario (RngRun 1..runs)", runs);
+  cmd.AddValue ("servers", "the number of chained services, used by --place=all", servers);
+  cmd.AddValue ("jobs", "the number of simulations run at once (default: the number of cores)", jobs);
+  cmd.AddValue ("path", "directory of the results (ex. /root/sweep)", path);
+  cmd.AddValue ("program", "the simulation binary (default: myNewMultiLayer next to this binary)", program);
+  cmd.Parse(argc, argv);
+
+  if(program.empty()){
+    program = argv[0];
+    size_t pos = program.rfind("mySweep");
+    NS_ABORT_MSG_IF(pos==std::string::npos, "set --program");
+    program.replace(pos, 7, "myNewMultiLayer");
+  }
+  if(program[0]!='/'){
+    char cwd[4096];
+    NS_ABORT_MSG_IF(!getcwd(cwd, sizeof(cwd)), "getcwd failed");
+    program = std::string(cwd)+"/"+program;
+  }
+  if(path[0]!='/'){
+    char cwd[4096];
+    NS_ABORT_MSG_IF(!getcwd(cwd, sizeof(cwd)), "getcwd failed");
+    path = std::string(cwd)+"/"+path;
+  }
+  if(mkdir(path.c_str(), 0755)==-1 && errno!=EEXIST){
+    NS_FATAL_ERROR("cannot create " << path << ": " << std::strerror(errno));
+  }
+  jobs = std::max<uint32_t>(1, jobs);
+
+  std::vector<Run> grid;
+  for(auto& t: stringSplit(topology, ',')){
+    std::vector<std::string> net = stringSplit(t, '/');
+    NS_ABORT_MSG_IF(net.size()!=3, "topology must be \"node/net/delay\": " << t);
+    std::vector<std::string> places = stringSplit(place, ',');
+    if(place=="all"){
+      places = allPlaces(stringSplit(net[0], '-').size(), servers);
+    }
+    for(auto& m: stringSplit(makespan, ',')){
+      for(auto& p: places){
+        for(uint32_t r=1; r<=runs; r++){
+          Run run;
+          run.id = grid.size();
+          run.node = net[0];
+          run.net = net[1];
+          run.delay = net[2];
+          run.makespan = m;
+          run.place = p;
+          run.rngRun = r;
+          run.dir = path+"/run-"+std::to_string(run.id);
+          grid.push_back(run);
+        }
+      }
+    }
+  }
+  std::cout << grid.size() << " runs on " << jobs << " processes" << std::endl;
+
+  std::ofstream ofs(path+"/mySweep.csv");
+  ofs << "run node net delay makespan place rng predicted simulated responses pending status" << std::endl;
+  std::map<pid_t, size_t> running;
+  size_t next = 0;
+  size_t done = 0;
+  while(done<grid.size()){
+    while(running.size()<jobs && next<grid.size()){
+      running[startRun(program, grid[next])] = next;
+      next++;
+    }
+    int status = 0;
+    pid_t pid = wait(&status);
+    if(pid==-1){
+      NS_FATAL_ERROR("wait failed: " << std::strerror(errno));
+    }
+    auto itr = running.find(pid);
+    if(itr==running.end()){
+      continue;
+    }
+    const Run& run = grid[itr->second];
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status);
+    writeResult(ofs, run, code);
+    running.erase(itr);
+    done++;
+    std::cout << "[" << done << "/" << grid.size() << "] run " << run.id << " place " << run.place
+              << " makespan " << run.makespan << " exit " << code << std::endl;
+  }
+  ofs.close();
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Convert a binary trace of MyTraceWriter to CSV.
+//
+// ./waf --run "myTraceToCsv --in=/root/result/myTrace.bin --out=/root/result/myTrace.csv"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/my-trace-writer.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MyTraceToCsv");
+
+int
+main(int argc, char *argv[])
+{
+  std::string in = "/root/result/myTrace.bin";
+  std::string out = "/root/result/myTrace.csv";
+
+  CommandLine cmd;
+  cmd.AddValue ("in", "binary trace file", in);
+  cmd.AddValue ("out", "CSV file", out);
+  cmd.Parse(argc, argv);
+
+  FILE* ifs = std::fopen(in.c_str(), "rb");
+  NS_ABORT_MSG_IF(!ifs, "cannot open " << in);
+  char magic[sizeof(MyTraceWriter::MAGIC)];
+  uint32_t recordSize = 0;
+  if(std::fread(magic, 1, sizeof(magic), ifs)!=sizeof(magic)
+     || std::memcmp(magic, MyTraceWriter::MAGIC, sizeof(magic))!=0
+     || std::fread(&recordSize, sizeof(recordSize), 1, ifs)!=1
+     || recordSize!=sizeof(MyTraceWriter::Record)){
+    NS_FATAL_ERROR(in << " is not a trace of this version");
+  }
+  FILE* ofs = std::fopen(out.c_str(), "w");
+  NS_ABORT_MSG_IF(!ofs, "cannot open " << out);
+  std::vector<char> outBuffer(1<<20);
+  std::setvbuf(ofs, outBuffer.data(), _IOFBF, outBuffer.size());
+
+  static const char* KIND[] = {"ClientTx", "ClientRx", "ServerRx", "ServerTx", "Queue"};
+  std::fprintf(ofs, "time node kind client sequence size value\n");
+  std::vector<MyTraceWriter::Record> records(65536);
+  size_t n;
+  while((n = std::fread(records.data(), sizeof(MyTraceWriter::Record), records.size(), ifs))>0){
+    for(size_t i=0; i<n; i++){
+      const MyTraceWriter::Record& r = records[i];
+      char client[16];
+      Ipv4Address(static_cast<uint32_t>(r.request>>32)).Serialize(reinterpret_cast<uint8_t*>(client));
+      std::fprintf(ofs, "%lld %u %s %u.%u.%u.%u %u %u %u\n",
+                   static_cast<long long>(r.time), r.node, r.kind<5 ? KIND[r.kind] : "?",
+                   static_cast<uint8_t>(client[0]), static_cast<uint8_t>(client[1]),
+                   static_cast<uint8_t>(client[2]), static_cast<uint8_t>(client[3]),
+                   static_cast<uint32_t>(r.request), r.size, r.value);
+    }
+  }
+  std::fclose(ifs);
+  std::fclose(ofs);
+
+  return 0;
+}
@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Benchmark the queue discs (with BQL or not) on the uplinks of the fog tree,
+// as myQueueDiscs.cc does on a dumbbell.
+//
+// ./waf --run "myTreeQueueDiscs --node=1-1-5-20 --layer=1 --queueDiscType=CoDel --bql=1"
+//
+// The links between --layer and the layer below get the queue disc. Two TCP
+// flows run between the first leaf and the root, one in each direction, the
+// first leaf pings the root, and the clients send their requests to the chain
+// of services as in myNewMultiLayer. The output is the ping RTT, the bytes in
+// the queue disc of the first uplink of the layer (and the BQL limit), the
+// goodput of the flows and the latency summary of the requests (myMetrics.txt).
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/internet-apps-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "ns3/my-tree.h"
+#include "ns3/my-orchestrator.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MyTreeQueueDiscs");
+
+static const double SIM_TIME = 21.0;
+
+std::vector<std::string> stringSplit(const std::string &str, char sep)
+{
+  std::vector<std::string> v;
+  std::stringstream ss(str);
+  std::string buffer;
+  while(getline(ss, buffer, sep)) {
+    v.push_back(buffer);
+  }
+  return v;
+}
+
+static void
+ValueTrace(Ptr<OutputStreamWrapper> stream, uint32_t oldVal, uint32_t newVal)
+{
+  *stream->GetStream() << Simulator::Now().GetSeconds() << " " << newVal << std::endl;
+}
+
+static void
+GoodputSampling(Ptr<PacketSink> sink, Ptr<OutputStreamWrapper> stream, double period)
+{
+  Simulator::Schedule(Seconds(period), &GoodputSampling, sink, stream, period);
+  double goodput = sink->GetTotalRx()*8/(Simulator::Now().GetSeconds()*1024); // Kbit/s
+  *stream->GetStream() << Simulator::Now().GetSeconds() << " " << goodput << std::endl;
+}
+
+static void
+PingRtt(Ptr<OutputStreamWrapper> stream, Time rtt)
+{
+  *stream->GetStream() << Simulator::Now().GetSeconds() << " " << rtt.GetMilliSeconds() << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  std::string nodeNum = "1-1-5-20";
+  std::string bands = "40Gbps-10Mbps-1Gbps";
+  std::string delays = "10ms-5ms-2ms";
+  std::string place = "0-0-0-0";
+  std::string path = "/root/result";
+  uint32_t makespan = 200000;
+  uint32_t layer = 1;
+  std::string queueDiscType = "PfifoFast";
+  uint32_t queueDiscSize = 1000;
+  uint32_t netdevicesQueueSize = 100;
+  bool bql = false;
+  std::string flowsDatarate = "20Mbps";
+  uint32_t flowsPacketsSize = 1000;
+  double samplingPeriod = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("node", "the number of nodes of each layer (ex. \"1-2-10\")", nodeNum);
+  cmd.AddValue ("net", "the bandwidth of net of each layer (ex. \"40Gbps-10Mbps-1Gbps\")", bands);
+  cmd.AddValue ("delay", "the delay of net of each layer (ex. \"10ms-5ms-2ms\")", delays);
+  cmd.AddValue ("place", "server place (ex. 0-0-0-0)", place);
+  cmd.AddValue ("path", "path of trace file (ex. /root/result)", path);
+  cmd.AddValue ("makespan", "interval of paket send(ex. 200000)", makespan);
+  cmd.AddValue ("layer", "upper layer of the links with the queue disc (ex. 1)", layer);
+  cmd.AddValue ("queueDiscType", "queue disc type in {PfifoFast, ARED, CoDel, FqCoDel, PIE}", queueDiscType);
+  cmd.AddValue ("queueDiscSize", "queue disc size in packets", queueDiscSize);
+  cmd.AddValue ("netdevicesQueueSize", "netdevices queue size in packets", netdevicesQueueSize);
+  cmd.AddValue ("bql", "enable byte queue limits on the netdevices", bql);
+  cmd.AddValue ("flowsDatarate", "upload and download flows datarate", flowsDatarate);
+  cmd.AddValue ("flowsPacketsSize", "upload and download flows packets sizes", flowsPacketsSize);
+  cmd.AddValue ("samplingPeriod", "goodput sampling period in seconds", samplingPeriod);
+  cmd.Parse(argc, argv);
+
+  std::vector<int> NODE_NUM;
+  for(auto& n: stringSplit(nodeNum, '-')){
+    NODE_NUM.push_back(std::atoi(n.c_str()));
+  }
+  std::vector<uint32_t> PLACE;
+  for(auto& n: stringSplit(place, '-')){
+    PLACE.push_back(std::atoi(n.c_str()));
+  }
+  NS_ABORT_MSG_IF(layer+1>=NODE_NUM.size(), "--layer has no links below it");
+
+  std::stringstream size;
+  size << "MaxSize=" << queueDiscSize << "p";
+  std::string queueDisc;
+  if(queueDiscType=="PfifoFast"){
+    queueDisc = "ns3::PfifoFastQueueDisc["+size.str()+"]";
+  }
+  else if(queueDiscType=="ARED"){
+    queueDisc = "ns3::RedQueueDisc[ARED=true|"+size.str()+"]";
+  }
+  else if(queueDiscType=="CoDel"){
+    queueDisc = "ns3::CoDelQueueDisc["+size.str()+"]";
+  }
+  else if(queueDiscType=="FqCoDel"){
+    queueDisc = "ns3::FqCoDelQueueDisc["+size.str()+"]";
+  }
+  else if(queueDiscType=="PIE"){
+    queueDisc = "ns3::PieQueueDisc["+size.str()+"]";
+  }
+  else{
+    NS_ABORT_MSG("--queueDiscType not valid");
+  }
+
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue(flowsPacketsSize));
+  Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue(13107200));
+  Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue(13107200));
+
+  PointToPointTreeHelper p2ptree(NODE_NUM, stringSplit(bands, '-'), stringSplit(delays, '-'));
+  p2ptree.SetQueueDisc(layer, queueDisc, std::to_string(netdevicesQueueSize)+"p", bql);
+
+  InternetStackHelper internet;
+  internet.SetIpv6StackInstall(false);
+  p2ptree.InstallStack(internet);
+  Ipv4AddressHelper address;
+  address.SetBase("10.0.1.0", "255.255.255.252");
+  p2ptree.AssignIpv4Addresses(address);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+
+  MyOrchestrator orch(p2ptree);
+  orch.SetSimulationTime(SIM_TIME);
+  std::stringstream off;
+  off<<"ns3::ExponentialRandomVariable[Mean="<<makespan<<"]";
+  orch.SetClientOffTime(off.str());
+  std::vector<double> mu{1,1,1,1};
+  uint32_t previous = orch.AddServerHelper(mu,Ipv4Address::GetAny());
+  for(size_t i=1; i<PLACE.size(); i++){
+    uint32_t next = orch.AddServerHelper(mu,Ipv4Address::GetAny());
+    orch.CreateChaine(previous, next);
+    previous = next;
+  }
+  orch.EnableMetrics();
+  orch.SetPlace(PLACE);
+  orch.SetPath(path);
+  orch.Assign();
+
+  // the bottleneck is the first uplink of the layer below --layer
+  Ptr<Node> leaf = p2ptree.GetNode(p2ptree.GetNLayers()-1,0,0);
+  Ptr<Node> root = p2ptree.GetNode(0,0,0);
+  Ptr<Node> bottleneck = p2ptree.GetNode(layer+1,0,0);
+  Ptr<NetDevice> device = bottleneck->GetObject<Ipv4>()->GetNetDevice(1);
+  Ptr<QueueDisc> queueDiscOnDevice = bottleneck->GetObject<TrafficControlLayer>()->GetRootQueueDiscOnDevice(device);
+  AsciiTraceHelper ascii;
+  std::string prefix = path+"/"+queueDiscType+(bql ? "-bql" : "");
+  queueDiscOnDevice->TraceConnectWithoutContext("BytesInQueue", MakeBoundCallback(&ValueTrace, ascii.CreateFileStream(prefix+"-bytesInQueue.txt")));
+  if(bql){
+    Ptr<NetDeviceQueue> queueInterface = device->GetObject<NetDeviceQueueInterface>()->GetTxQueue(0);
+    queueInterface->GetQueueLimits()->TraceConnectWithoutContext("Limit", MakeBoundCallback(&ValueTrace, ascii.CreateFileStream(prefix+"-limits.txt")));
+  }
+
+  // bidirectional TCP streams and a ping, like the flent tcp_bidirectional test
+  ApplicationContainer sinks;
+  ApplicationContainer sources;
+  uint16_t port = 7;
+  std::vector<std::pair<Ptr<Node>, Ptr<Node>>> flows{{leaf, root}, {root, leaf}};
+  for(auto& flow: flows){
+    PacketSinkHelper sinkHelper("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+    sinks.Add(sinkHelper.Install(flow.second));
+    OnOffHelper onOffHelper("ns3::TcpSocketFactory", InetSocketAddress(p2ptree.GetIpv4Address(flow.second->GetId(), 1), port));
+    onOffHelper.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
+    onOffHelper.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
+    onOffHelper.SetAttribute("PacketSize", UintegerValue(flowsPacketsSize));
+    onOffHelper.SetAttribute("DataRate", StringValue(flowsDatarate));
+    sources.Add(onOffHelper.Install(flow.first));
+    port++;
+  }
+  V4PingHelper ping(p2ptree.GetIpv4Address(root->GetId(), 1));
+  ApplicationContainer pingApp = ping.Install(leaf);
+  pingApp.Get(0)->TraceConnectWithoutContext("Rtt", MakeBoundCallback(&PingRtt, ascii.CreateFileStream(prefix+"-rtt.txt")));
+
+  sinks.Start(Seconds(0));
+  sinks.Stop(Seconds(SIM_TIME));
+  sources.Start(Seconds(1.1));
+  sources.Stop(Seconds(SIM_TIME-0.1));
+  pingApp.Start(Seconds(1.0));
+  pingApp.Stop(Seconds(SIM_TIME));
+  Simulator::Schedule(Seconds(samplingPeriod), &GoodputSampling, DynamicCast<PacketSink>(sinks.Get(0)),
+                      ascii.CreateFileStream(prefix+"-upGoodput.txt"), samplingPeriod);
+  Simulator::Schedule(Seconds(samplingPeriod), &GoodputSampling, DynamicCast<PacketSink>(sinks.Get(1)),
+                      ascii.CreateFileStream(prefix+"-downGoodput.txt"), samplingPeriod);
+
+  Simulator::Stop(Seconds(SIM_TIME+10));
+  Simulator::Run();
+  Simulator::Destroy();
+
+  return 0;
+}
@@ -26,11 +26,10 @@
 
 namespace ns3 {
 
-MyReceiveServerHelper::MyReceiveServerHelper (std::string protocol, uint32_t pktSize, Address address)
+MyReceiveServerHelper::MyReceiveServerHelper (std::string protocol, Address address)
 {
   m_factory.SetTypeId("ns3::MyReceiveServer");
   m_factory.Set("Protocol", StringValue (protocol));
-  m_factory.Set("PacketSize", UintegerValue(pktSize));
   m_factory.Set("Local", AddressValue (address));
 }
 
@@ -46,7 +46,7 @@ public:
    * \param address the address of the sink,
    *
    */
-  MyReceiveServerHelper (std::string protocol, uint32_t pktSize, Address address);
+  MyReceiveServerHelper (std::string protocol, Address address);
 
   /**
    * Helper function used to set the underlying application attributes.
@@ -29,11 +29,10 @@ namespace ns3 {
 MyTcpServerHelper::MyTcpServerHelper (){
 }
 
-MyTcpServerHelper::MyTcpServerHelper (std::string protocol, uint32_t pktSize, double meanCalctime, Address address, Address nextService)
+MyTcpServerHelper::MyTcpServerHelper (std::string protocol, double meanCalctime, Address address, Address nextService)
 {
   m_factory.SetTypeId("ns3::MyTcpServer");
   m_factory.Set("Protocol", StringValue (protocol));
-  m_factory.Set("PacketSize", UintegerValue(pktSize));
   m_factory.Set("Local", AddressValue (address));
   std::stringstream calctime;
   calctime << "ns3::ExponentialRandomVariable[Mean="<<meanCalctime<<"]";
@@ -41,11 +40,10 @@ MyTcpServerHelper::MyTcpServerHelper (std::string protocol, uint32_t pktSize, do
   m_factory.Set("NextService", AddressValue(nextService));
 }
 
-MyTcpServerHelper::MyTcpServerHelper (std::string protocol, uint32_t pktSize, double meanCalctime, Address address)
+MyTcpServerHelper::MyTcpServerHelper (std::string protocol, double meanCalctime, Address address)
 {
   m_factory.SetTypeId("ns3::MyTcpServer");
   m_factory.Set("Protocol", StringValue (protocol));
-  m_factory.Set("PacketSize", UintegerValue(pktSize));
   m_factory.Set("Local", AddressValue (address));
   std::stringstream calctime;
   calctime << "ns3::ExponentialRandomVariable[Mean="<<meanCalctime<<"]";
@@ -92,4 +90,24 @@ MyTcpServerHelper::InstallPriv (Ptr<Node> node) const
   return app;
 }
 
+int64_t
+MyTcpServerHelper::AssignStreams (NodeContainer c, int64_t stream)
+{
+  int64_t currentStream = stream;
+  Ptr<Node> node;
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      node = (*i);
+      for (uint32_t j = 0; j < node->GetNApplications (); j++)
+        {
+          Ptr<MyTcpServer> server = DynamicCast<MyTcpServer> (node->GetApplication (j));
+          if (server)
+            {
+              currentStream += server->AssignStreams (currentStream);
+            }
+        }
+    }
+  return (currentStream - stream);
+}
+
 } // namespace ns3
@@ -32,8 +32,8 @@ class MyTcpServerHelper
 {
 public:
   MyTcpServerHelper();
-  MyTcpServerHelper(std::string protocol, uint32_t pktSize, double meanCalctime, Address address);
-  MyTcpServerHelper(std::string protocol, uint32_t pktSize, double meanCalctime, Address address, Address nextService);
+  MyTcpServerHelper(std::string protocol, double meanCalctime, Address address);
+  MyTcpServerHelper(std::string protocol, double meanCalctime, Address address, Address nextService);
 
   void SetAttribute (std::string name, const AttributeValue &value);
 
@@ -43,6 +43,15 @@ public:
 
   ApplicationContainer Install (std::string nodeName) const;
 
+  /**
+   * Assign fixed random variable streams to the MyTcpServer applications
+   * installed on the nodes.
+   * \param c the nodes
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this helper
+   */
+  int64_t AssignStreams (NodeContainer c, int64_t stream);
+
 private:
   Ptr<Application> InstallPriv (Ptr<Node> node) const;
   ObjectFactory m_factory; //!< Object factory.
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement the timestamps a request collects at each service.
+
+#include "ns3/json.h"
+
+#include "my-hop-tag.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (MyHopTag);
+
+json11::Json MyHop::AppendTo(const json11::Json& request) const{
+  json11::Json::object obj = request.object_items();
+  if(request["Members"].is_array()){
+    json11::Json::array members;
+    for(auto& member: request["Members"].array_items()){
+      members.push_back(AppendTo(member));
+    }
+    obj["Members"] = members;
+    return obj;
+  }
+  json11::Json::array hops = request["Hops"].array_items();
+  hops.push_back(json11::Json::object({
+    {"Node", static_cast<int>(node)},
+    {"Rx", static_cast<double>(rx.GetNanoSeconds())},
+    {"Start", static_cast<double>(start.GetNanoSeconds())},
+    {"Done", static_cast<double>(done.GetNanoSeconds())},
+  }));
+  obj["Hops"] = hops;
+  return obj;
+}
+
+std::vector<MyHop> MyHop::Parse(const json11::Json& request){
+  std::vector<MyHop> hops;
+  for(auto& i: request["Hops"].array_items()){
+    MyHop hop;
+    hop.node = i["Node"].int_value();
+    hop.rx = NanoSeconds(static_cast<int64_t>(i["Rx"].number_value()));
+    hop.start = NanoSeconds(static_cast<int64_t>(i["Start"].number_value()));
+    hop.done = NanoSeconds(static_cast<int64_t>(i["Done"].number_value()));
+    hops.push_back(hop);
+  }
+  return hops;
+}
+
+TypeId
+MyHopTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MyHopTag")
+    .SetParent<Tag> ()
+    .SetGroupName("Applications")
+    .AddConstructor<MyHopTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+MyHopTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+MyHopTag::MyHopTag ()
+{
+}
+
+MyHopTag::MyHopTag (Time rx)
+  : m_rx(rx),
+    m_start(rx)
+{
+}
+
+uint32_t
+MyHopTag::GetSerializedSize (void) const
+{
+  return 16;
+}
+
+void
+MyHopTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (m_rx.GetNanoSeconds ());
+  i.WriteU64 (m_start.GetNanoSeconds ());
+}
+
+void
+MyHopTag::Deserialize (TagBuffer i)
+{
+  m_rx = NanoSeconds (i.ReadU64 ());
+  m_start = NanoSeconds (i.ReadU64 ());
+}
+
+void
+MyHopTag::Print (std::ostream &os) const
+{
+  os << "rx=" << m_rx << " start=" << m_start;
+}
+
+Time MyHopTag::GetRx (void) const{
+  return m_rx;
+}
+
+Time MyHopTag::GetStart (void) const{
+  return m_start;
+}
+
+void MyHopTag::SetStart (Time start){
+  m_start = start;
+}
+
+} // namespace ns3
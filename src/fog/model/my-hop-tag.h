@@ -0,0 +1,80 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define the timestamps a request collects at each service.
+
+#ifndef MY_HOP_TAG_H
+#define MY_HOP_TAG_H
+
+#include <vector>
+#include "ns3/tag.h"
+#include "ns3/nstime.h"
+
+namespace json11 {
+class Json;
+}
+
+namespace ns3 {
+
+/**
+ * Timestamps of a request at one service, appended to "Hops" of the request.
+ */
+struct MyHop
+{
+  uint32_t node;
+  Time rx;      //!< received by the service
+  Time start;   //!< service started
+  Time done;    //!< service completed
+
+  /**
+   * \return the request with this hop appended, to every member of an aggregate
+   */
+  json11::Json AppendTo(const json11::Json& request) const;
+  /**
+   * \return the hops stored in the request
+   */
+  static std::vector<MyHop> Parse(const json11::Json& request);
+};
+
+/**
+ * Keeps the receive and start times of a request while it waits in a service.
+ */
+class MyHopTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  MyHopTag ();
+  MyHopTag (Time rx);
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  Time GetRx (void) const;
+  Time GetStart (void) const;
+  void SetStart (Time start);
+
+private:
+  Time m_rx;
+  Time m_start;
+};
+
+} // namespace ns3
+
+#endif /* MY_HOP_TAG_H */
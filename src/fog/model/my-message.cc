@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement the framing of the messages between the applications.
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/json.h"
+
+#include "my-message.h"
+
+namespace ns3 {
+
+static void
+WriteU32(uint8_t* buf, uint32_t value)
+{
+  buf[0] = value>>24;
+  buf[1] = value>>16;
+  buf[2] = value>>8;
+  buf[3] = value;
+}
+
+static uint32_t
+ReadU32(const uint8_t* buf)
+{
+  return (static_cast<uint32_t>(buf[0])<<24) | (static_cast<uint32_t>(buf[1])<<16)
+         | (static_cast<uint32_t>(buf[2])<<8) | buf[3];
+}
+
+Ptr<Packet> MyMessage::CreateFrame(const std::string& text, uint32_t size){
+  uint32_t textSize = HEADER_SIZE+text.size();
+  uint32_t frameSize = std::max(size, textSize);
+  std::vector<uint8_t> buf(textSize);
+  WriteU32(buf.data(), frameSize);
+  WriteU32(buf.data()+4, text.size());
+  std::copy(text.begin(), text.end(), buf.begin()+HEADER_SIZE);
+  Ptr<Packet> frame = Create<Packet>(buf.data(), textSize);
+  if(frameSize>textSize){
+    frame->AddAtEnd(Create<Packet>(frameSize-textSize));
+  }
+  return frame;
+}
+
+bool MyMessage::Pop(Ptr<Packet> buffer, Ptr<Packet>& frame){
+  if(buffer->GetSize()<HEADER_SIZE){
+    return false;
+  }
+  uint8_t header[HEADER_SIZE];
+  buffer->CopyData(header, HEADER_SIZE);
+  uint32_t size = ReadU32(header);
+  NS_ABORT_MSG_IF(size<HEADER_SIZE+ReadU32(header+4), "MyMessage >> broken frame of "<<size<<" bytes");
+  if(buffer->GetSize()<size){
+    return false;
+  }
+  frame = buffer->CreateFragment(0, size);
+  buffer->RemoveAtStart(size);
+  return true;
+}
+
+std::string MyMessage::GetText(Ptr<const Packet> frame){
+  if(frame->GetSize()<HEADER_SIZE){
+    return std::string();
+  }
+  uint8_t header[HEADER_SIZE];
+  frame->CopyData(header, HEADER_SIZE);
+  // only the text is copied, not the padding
+  uint32_t textSize = std::min(ReadU32(header+4), frame->GetSize()-HEADER_SIZE);
+  std::vector<uint8_t> buf(HEADER_SIZE+textSize);
+  frame->CopyData(buf.data(), buf.size());
+  return std::string(buf.begin()+HEADER_SIZE, buf.end());
+}
+
+json11::Json MyMessage::Parse(Ptr<const Packet> frame){
+  std::string err;
+  return json11::Json::parse(GetText(frame), err);
+}
+
+std::string MyMessage::FormatRequestId(uint64_t id){
+  return std::to_string(id);
+}
+
+uint64_t MyMessage::GetRequestId(const json11::Json& request){
+  return std::strtoull(request["Id"].string_value().c_str(), nullptr, 10);
+}
+
+std::vector<uint64_t> MyMessage::GetRequestIds(Ptr<const Packet> frame){
+  // the key as written by Json::dump, a quote in a string value is escaped
+  static const std::string key = "\"Id\": \"";
+  std::string text = GetText(frame);
+  std::vector<uint64_t> ids;
+  for(size_t pos = text.find(key); pos!=std::string::npos; pos = text.find(key, pos)){
+    pos += key.size();
+    ids.push_back(std::strtoull(text.c_str()+pos, nullptr, 10));
+  }
+  return ids;
+}
+
+} // namespace ns3
@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define the framing of the messages between the applications.
+
+#ifndef MY_MESSAGE_H
+#define MY_MESSAGE_H
+
+#include <string>
+#include <vector>
+#include "ns3/packet.h"
+
+namespace json11 {
+class Json;
+}
+
+namespace ns3 {
+
+/**
+ * A message on a TCP stream is a frame of
+ *   [frame size (4 bytes)][text size (4 bytes)][JSON text][zero padding],
+ * sizes in network byte order. The frame size is the size of the message on
+ * the wire, so it is independent of the text, and the padding is a zero
+ * area of the packet which takes no memory.
+ */
+class MyMessage
+{
+public:
+  static const uint32_t HEADER_SIZE = 8;
+
+  /**
+   * \param size the size of the frame, at least the header and the text
+   */
+  static Ptr<Packet> CreateFrame(const std::string& text, uint32_t size = 0);
+  /**
+   * Remove the first frame of a stream buffer.
+   * \return false if the buffer does not hold a whole frame yet
+   */
+  static bool Pop(Ptr<Packet> buffer, Ptr<Packet>& frame);
+  static std::string GetText(Ptr<const Packet> frame);
+  static json11::Json Parse(Ptr<const Packet> frame);
+
+  /**
+   * The "Id" of a request is its client address << 32 | its sequence number.
+   * It is a decimal string, as JSON numbers are doubles.
+   */
+  static std::string FormatRequestId(uint64_t id);
+  /**
+   * \return the id of the request, 0 if it has none
+   */
+  static uint64_t GetRequestId(const json11::Json& request);
+  /**
+   * Read the request ids from the text of a frame without parsing it, for
+   * the per-packet trace hooks. An aggregate holds the ids of its members.
+   */
+  static std::vector<uint64_t> GetRequestIds(Ptr<const Packet> frame);
+};
+
+} // namespace ns3
+
+#endif /* MY_MESSAGE_H */
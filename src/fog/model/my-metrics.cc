@@ -0,0 +1,285 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement an in-simulator collector of latency, throughput and queue statistics.
+
+#include <algorithm>
+#include <cmath>
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/my-message.h"
+
+#include "my-metrics.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MyMetrics");
+
+MyLatencyHistogram::MyLatencyHistogram (uint32_t bits)
+  : m_bits(bits),
+    m_count(0),
+    m_sum(0),
+    m_max(0)
+{
+}
+
+uint32_t MyLatencyHistogram::GetIndex(uint64_t value) const{
+  if(value<(1ULL<<m_bits)){
+    return value;
+  }
+  uint32_t msb = 63-__builtin_clzll(value);
+  uint32_t shift = msb-m_bits+1;
+  return (shift<<(m_bits-1))+(value>>shift);
+}
+
+uint64_t MyLatencyHistogram::GetValue(uint32_t index) const{
+  if(index<(1U<<m_bits)){
+    return index;
+  }
+  uint32_t shift = (index>>(m_bits-1))-1;
+  uint64_t sub = index-(shift<<(m_bits-1));
+  return (sub<<shift)+((1ULL<<shift)>>1);
+}
+
+void MyLatencyHistogram::Record(Time value){
+  uint64_t ns = std::max<int64_t>(0, value.GetNanoSeconds());
+  uint32_t index = GetIndex(ns);
+  if(index>=m_counts.size()){
+    m_counts.resize(index+1, 0);
+  }
+  m_counts[index]++;
+  m_count++;
+  m_sum += ns;
+  m_max = std::max(m_max, ns);
+}
+
+uint64_t MyLatencyHistogram::GetCount() const{
+  return m_count;
+}
+
+Time MyLatencyHistogram::GetMean() const{
+  return m_count>0 ? NanoSeconds(m_sum/m_count) : Time(0);
+}
+
+Time MyLatencyHistogram::GetMax() const{
+  return NanoSeconds(m_max);
+}
+
+Time MyLatencyHistogram::GetPercentile(double p) const{
+  if(m_count==0){
+    return Time(0);
+  }
+  uint64_t rank = std::max<uint64_t>(1, std::ceil(p/100.0*m_count));
+  uint64_t seen = 0;
+  for(size_t i=0; i<m_counts.size(); i++){
+    seen += m_counts[i];
+    if(seen>=rank){
+      return NanoSeconds(std::min(GetValue(i), m_max));
+    }
+  }
+  return NanoSeconds(m_max);
+}
+
+MyMetrics::MyMetrics ()
+  : m_sampleRate(1),
+    m_sampleBound(0),
+    m_nSent(0),
+    m_nReceived(0),
+    m_rxBytes(0)
+{
+}
+
+std::vector<uint64_t> MyMetrics::GetRequestIds(Ptr<const Packet> packet){
+  // the sampling only needs the ids, so the text is not parsed
+  return MyMessage::GetRequestIds(packet);
+}
+
+void MyMetrics::SetSampleRate(double rate){
+  m_sampleRate = rate;
+  m_sampleBound = rate>=1 ? 0 : static_cast<uint64_t>(std::ldexp(std::max(rate, 0.0), 64));
+}
+
+bool MyMetrics::IsSampled(uint64_t id) const{
+  if(m_sampleRate>=1){
+    return true;
+  }
+  // splitmix64 finalizer
+  id ^= id>>30;
+  id *= 0xbf58476d1ce4e5b9ULL;
+  id ^= id>>27;
+  id *= 0x94d049bb133111ebULL;
+  id ^= id>>31;
+  return id<m_sampleBound;
+}
+
+void MyMetrics::RequestSent(uint32_t group, Ptr<const Packet> packet){
+  if(m_nSent==0){
+    m_firstSent = Simulator::Now();
+  }
+  m_nSent++;
+  for(auto id: GetRequestIds(packet)){
+    if(IsSampled(id)){
+      m_sent[id] = Simulator::Now();
+    }
+  }
+}
+
+void MyMetrics::ResponseReceived(uint32_t group, Ptr<const Packet> packet){
+  for(auto id: GetRequestIds(packet)){
+    if(IsSampled(id)){
+      auto itr = m_sent.find(id);
+      if(itr==m_sent.end()){
+        continue;
+      }
+      m_endToEnd.Record(Simulator::Now()-itr->second);
+      m_groupEndToEnd[group].Record(Simulator::Now()-itr->second);
+      m_sent.erase(itr);
+    }
+    m_nReceived++;
+    m_rxBytes += packet->GetSize();
+    m_lastReceived = Simulator::Now();
+  }
+}
+
+void MyMetrics::StageReceived(uint32_t stage, Ptr<const Packet> packet){
+  std::unordered_map<uint64_t, Time>& in = m_stageIn[stage];
+  for(auto id: GetRequestIds(packet)){
+    if(IsSampled(id)){
+      in[id] = Simulator::Now();
+    }
+  }
+}
+
+void MyMetrics::StageSent(uint32_t stage, uint32_t group, Ptr<const Packet> packet){
+  std::unordered_map<uint64_t, Time>& in = m_stageIn[stage];
+  for(auto id: GetRequestIds(packet)){
+    if(!IsSampled(id)){
+      continue;
+    }
+    auto itr = in.find(id);
+    if(itr==in.end()){
+      continue;
+    }
+    m_stage[stage].Record(Simulator::Now()-itr->second);
+    m_groupStage[Key(stage, group)].Record(Simulator::Now()-itr->second);
+    in.erase(itr);
+  }
+}
+
+void MyMetrics::AddQueue(uint32_t layer, uint32_t group){
+  m_queue[Key(layer, group)].nDevices++;
+}
+
+void MyMetrics::QueueChanged(uint32_t layer, uint32_t group, uint32_t oldLen, uint32_t newLen){
+  QueueStats& stats = m_queue[Key(layer, group)];
+  stats.area += stats.current*(Simulator::Now()-stats.updated).GetSeconds();
+  stats.updated = Simulator::Now();
+  stats.current = stats.current+newLen-oldLen;
+  stats.max = std::max(stats.max, newLen);
+}
+
+void MyMetrics::Breakdown(uint64_t id, const Time& created, const std::vector<MyHop>& hops){
+  if(!IsSampled(id)){
+    return;
+  }
+  Time last = created;
+  for(uint32_t i=0; i<hops.size(); i++){
+    m_hopNetwork[i].Record(hops[i].rx-last);
+    m_hopQueue[i].Record(hops[i].start-hops[i].rx);
+    m_hopService[i].Record(hops[i].done-hops[i].start);
+    last = hops[i].done;
+  }
+  m_hopNetwork[hops.size()].Record(Simulator::Now()-last);
+}
+
+const MyLatencyHistogram& MyMetrics::GetEndToEnd() const{
+  return m_endToEnd;
+}
+
+static void
+WriteHistogram(std::ostream& os, const std::string& name, const MyLatencyHistogram& h)
+{
+  os << name << " " << h.GetCount()
+     << " " << h.GetMean().GetMicroSeconds()
+     << " " << h.GetPercentile(50).GetMicroSeconds()
+     << " " << h.GetPercentile(90).GetMicroSeconds()
+     << " " << h.GetPercentile(99).GetMicroSeconds()
+     << " " << h.GetPercentile(99.9).GetMicroSeconds()
+     << " " << h.GetMax().GetMicroSeconds() << "\n";
+}
+
+void MyMetrics::Report(std::ostream& os){
+  os << "# latency [us]: name count mean p50 p90 p99 p99.9 max\n";
+  WriteHistogram(os, "end-to-end", m_endToEnd);
+  if(m_groupEndToEnd.size()>1){
+    for(auto& i: m_groupEndToEnd){
+      WriteHistogram(os, "end-to-end-group-"+std::to_string(i.first), i.second);
+    }
+  }
+  for(auto& i: m_stage){
+    WriteHistogram(os, "stage-"+std::to_string(i.first), i.second);
+  }
+  if(m_groupEndToEnd.size()>1){
+    for(auto& i: m_groupStage){
+      WriteHistogram(os, "stage-"+std::to_string(i.first.first)+"-group-"+std::to_string(i.first.second), i.second);
+    }
+  }
+  for(auto& i: m_hopNetwork){
+    WriteHistogram(os, "hop-"+std::to_string(i.first)+"-network", i.second);
+    if(m_hopQueue.count(i.first)){
+      WriteHistogram(os, "hop-"+std::to_string(i.first)+"-queue", m_hopQueue[i.first]);
+      WriteHistogram(os, "hop-"+std::to_string(i.first)+"-service", m_hopService[i.first]);
+    }
+  }
+
+  double elapsed = (m_lastReceived-m_firstSent).GetSeconds();
+  os << "# throughput: sent received pending responses/s bytes/s\n";
+  os << "throughput " << m_nSent << " " << m_nReceived << " " << m_sent.size()
+     << " " << (elapsed>0 ? m_nReceived/elapsed : 0)
+     << " " << (elapsed>0 ? m_rxBytes/elapsed : 0) << "\n";
+  if(m_sampleRate<1){
+    os << "# latencies and pending requests are from a sample of " << m_sampleRate << " of the requests\n";
+  }
+
+  os << "# queue [packets]: layer devices mean-per-device max\n";
+  std::map<uint32_t, QueueStats> layers;
+  std::map<uint32_t, uint32_t> nGroups;
+  for(auto& i: m_queue){
+    QueueChanged(i.first.first, i.first.second, 0, 0);
+    QueueStats& layer = layers[i.first.first];
+    layer.nDevices += i.second.nDevices;
+    layer.area += i.second.area;
+    layer.max = std::max(layer.max, i.second.max);
+    nGroups[i.first.first]++;
+  }
+  auto mean = [](const QueueStats& stats){
+    return Simulator::Now().IsZero() || stats.nDevices==0 ? 0
+           : stats.area/Simulator::Now().GetSeconds()/stats.nDevices;
+  };
+  for(auto& i: layers){
+    os << "queue-" << i.first << " " << i.second.nDevices << " " << mean(i.second) << " " << i.second.max << "\n";
+  }
+  for(auto& i: m_queue){
+    if(nGroups[i.first.first]>1){
+      os << "queue-" << i.first.first << "-group-" << i.first.second << " " << i.second.nDevices
+         << " " << mean(i.second) << " " << i.second.max << "\n";
+    }
+  }
+  os.flush();
+}
+
+} // namespace ns3
@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define an in-simulator collector of latency, throughput and queue statistics.
+
+#ifndef MY_METRICS_H
+#define MY_METRICS_H
+
+#include <map>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/my-hop-tag.h"
+
+namespace ns3 {
+
+/**
+ * Latency histogram with log-linear buckets (HDR style).
+ * Values below 2^bits are exact, larger values keep bits-1 significant
+ * bits, so the relative error is below 2^-(bits-1) and the memory is
+ * bounded by (65-bits)*2^(bits-1) counters.
+ */
+class MyLatencyHistogram
+{
+public:
+  MyLatencyHistogram (uint32_t bits = 8);
+
+  void Record(Time value);
+  uint64_t GetCount() const;
+  Time GetMean() const;
+  Time GetMax() const;
+  /**
+   * \param p percentile in [0,100]
+   */
+  Time GetPercentile(double p) const;
+
+  uint32_t GetIndex(uint64_t value) const;
+  uint64_t GetValue(uint32_t index) const; //!< middle of the bucket
+
+private:
+  uint32_t m_bits;
+  std::vector<uint64_t> m_counts;
+  uint64_t m_count;
+  double m_sum;
+  uint64_t m_max;
+};
+
+/**
+ * Match requests with their responses by request id and keep
+ * streaming statistics instead of per-packet trace rows.
+ * Statistics are kept per group as well when several groups are traced,
+ * and latencies can be taken from a hash-sampled subset of the requests.
+ */
+class MyMetrics : public SimpleRefCount<MyMetrics>
+{
+public:
+  MyMetrics ();
+
+  /**
+   * \return ids of the requests in the packet, several for an aggregate
+   */
+  static std::vector<uint64_t> GetRequestIds(Ptr<const Packet> packet);
+
+  /**
+   * Keep latencies of a fraction of the requests only. The decision is a
+   * hash of the request id, so a request is sampled at every stage or at none.
+   */
+  void SetSampleRate(double rate);
+  bool IsSampled(uint64_t id) const;
+
+  void RequestSent(uint32_t group, Ptr<const Packet> packet);
+  void ResponseReceived(uint32_t group, Ptr<const Packet> packet);
+  void StageReceived(uint32_t stage, Ptr<const Packet> packet);
+  void StageSent(uint32_t stage, uint32_t group, Ptr<const Packet> packet);
+  void AddQueue(uint32_t layer, uint32_t group);
+  void QueueChanged(uint32_t layer, uint32_t group, uint32_t oldLen, uint32_t newLen);
+  /**
+   * Split the latency of a response into network, queueing and service time per hop.
+   */
+  void Breakdown(uint64_t id, const Time& created, const std::vector<MyHop>& hops);
+
+  const MyLatencyHistogram& GetEndToEnd() const;
+  void Report(std::ostream& os);
+
+private:
+  struct QueueStats
+  {
+    uint32_t nDevices = 0;
+    uint64_t current = 0;  //!< packets in the queues of the layer
+    double area = 0;       //!< integral of current [packets*s]
+    uint32_t max = 0;      //!< longest queue of a device
+    Time updated;
+  };
+
+  typedef std::pair<uint32_t, uint32_t> Key; //!< stage or layer, and group
+
+  double m_sampleRate;
+  uint64_t m_sampleBound;
+  std::unordered_map<uint64_t, Time> m_sent;
+  std::map<uint32_t, std::unordered_map<uint64_t, Time>> m_stageIn;
+  MyLatencyHistogram m_endToEnd;
+  std::map<uint32_t, MyLatencyHistogram> m_groupEndToEnd;
+  std::map<uint32_t, MyLatencyHistogram> m_stage;
+  std::map<Key, MyLatencyHistogram> m_groupStage;
+  std::map<Key, QueueStats> m_queue;
+  std::map<uint32_t, MyLatencyHistogram> m_hopNetwork;  //!< arrival at hop i, the last entry is the way back
+  std::map<uint32_t, MyLatencyHistogram> m_hopQueue;
+  std::map<uint32_t, MyLatencyHistogram> m_hopService;
+  uint64_t m_nSent;
+  uint64_t m_nReceived;
+  uint64_t m_rxBytes;
+  Time m_firstSent;
+  Time m_lastReceived;
+};
+
+} // namespace ns3
+
+#endif /* MY_METRICS_H */
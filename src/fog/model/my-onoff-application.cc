@@ -20,10 +20,16 @@
 #include "ns3/string.h"
 #include "ns3/pointer.h"
 #include "ns3/ipv4.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/abort.h"
+#include "ns3/my-message.h"
 #include "my-onoff-application.h"
 
 #include <sstream>
 #include <map>
+#include <cmath>
+#include <algorithm>
 #include "ns3/json.h"
 
 /**
@@ -38,6 +44,21 @@ NS_LOG_COMPONENT_DEFINE("MyOnOffApplication");
 
 NS_OBJECT_ENSURE_REGISTERED(MyOnOffApplication);
 
+// the clients of a burst group draw the bursts from the same stream, so they fire together
+static const int64_t BURST_STREAM = 1LL<<40;
+
+static std::vector<double>
+ParseList(const std::string& str)
+{
+  std::vector<double> v;
+  std::stringstream ss(str);
+  std::string buffer;
+  while(std::getline(ss, buffer, '-')){
+    v.push_back(std::atof(buffer.c_str()));
+  }
+  return v;
+}
+
 TypeId
 MyOnOffApplication::GetTypeId(void)
 {
@@ -49,7 +70,7 @@ MyOnOffApplication::GetTypeId(void)
                    DataRateValue(DataRate("500kb/s")),
                    MakeDataRateAccessor(&MyOnOffApplication::m_cbrRate),
                    MakeDataRateChecker())
-    .AddAttribute("PacketSize", "The size of packets sent in on state",
+    .AddAttribute("PacketSize", "The size of a request on the wire, unless RequestSize is set",
                    UintegerValue(512),
                    MakeUintegerAccessor(&MyOnOffApplication::m_pktSize),
                    MakeUintegerChecker<uint32_t>(1))
@@ -65,6 +86,72 @@ MyOnOffApplication::GetTypeId(void)
                    StringValue("ns3::ConstantRandomVariable[Constant=1.0]"),
                    MakePointerAccessor(&MyOnOffApplication::m_offTime),
                    MakePointerChecker <RandomVariableStream>())
+    .AddAttribute("Arrival", "The arrival process of the requests.",
+                   EnumValue(ARRIVAL_OFF_TIME),
+                   MakeEnumAccessor(&MyOnOffApplication::m_arrival),
+                   MakeEnumChecker(ARRIVAL_OFF_TIME, "OffTime",
+                                   ARRIVAL_MMPP, "Mmpp",
+                                   ARRIVAL_PARETO, "Pareto"))
+    .AddAttribute("MmppMeans", "The mean time [us] between requests in each state of the MMPP, \"-\" separated, 0 for a silent state.",
+                   StringValue("1000000-100000"),
+                   MakeStringAccessor(&MyOnOffApplication::m_mmppMeans),
+                   MakeStringChecker())
+    .AddAttribute("MmppDwell", "The mean time [us] in each state of the MMPP, \"-\" separated. The states follow each other in a cycle.",
+                   StringValue("10000000-1000000"),
+                   MakeStringAccessor(&MyOnOffApplication::m_mmppDwell),
+                   MakeStringChecker())
+    .AddAttribute("ParetoSources", "The number of superposed on/off sources of the Pareto process.",
+                   UintegerValue(10),
+                   MakeUintegerAccessor(&MyOnOffApplication::m_paretoSources),
+                   MakeUintegerChecker<uint32_t>(1))
+    .AddAttribute("ParetoShape", "The shape of the Pareto on and off periods, in (1,2) for a self-similar superposition.",
+                   DoubleValue(1.5),
+                   MakeDoubleAccessor(&MyOnOffApplication::m_paretoShape),
+                   MakeDoubleChecker<double>())
+    .AddAttribute("ParetoOn", "The mean on period [us] of a Pareto source.",
+                   DoubleValue(1000000),
+                   MakeDoubleAccessor(&MyOnOffApplication::m_paretoOn),
+                   MakeDoubleChecker<double>(0))
+    .AddAttribute("ParetoOff", "The mean off period [us] of a Pareto source.",
+                   DoubleValue(10000000),
+                   MakeDoubleAccessor(&MyOnOffApplication::m_paretoOff),
+                   MakeDoubleChecker<double>(0))
+    .AddAttribute("ParetoInterval", "The time [us] between the requests of a Pareto source in its on period.",
+                   DoubleValue(100000),
+                   MakeDoubleAccessor(&MyOnOffApplication::m_paretoInterval),
+                   MakeDoubleChecker<double>(0))
+    .AddAttribute("BurstInterval", "The mean time [us] between the bursts of the burst group, 0 disables the bursts.",
+                   DoubleValue(0),
+                   MakeDoubleAccessor(&MyOnOffApplication::m_burstInterval),
+                   MakeDoubleChecker<double>(0))
+    .AddAttribute("BurstSize", "The mean number of requests (geometric) sent by every client of the group in a burst.",
+                   DoubleValue(1),
+                   MakeDoubleAccessor(&MyOnOffApplication::m_burstSize),
+                   MakeDoubleChecker<double>(1))
+    .AddAttribute("BurstGroup", "The burst group of the client, the clients of a group send their bursts at the same times.",
+                   UintegerValue(0),
+                   MakeUintegerAccessor(&MyOnOffApplication::m_burstGroup),
+                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute("RequestSize", "A RandomVariableStream used to pick the size [bytes] of a request on the wire. PacketSize if not set.",
+                   PointerValue(),
+                   MakePointerAccessor(&MyOnOffApplication::m_size),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute("Key", "A RandomVariableStream used to pick the key of a request (e.g. ns3::ZipfRandomVariable). No key is sent if not set.",
+                   PointerValue(),
+                   MakePointerAccessor(&MyOnOffApplication::m_key),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute("Outstanding", "The number of requests in flight of a closed-loop client, 0 sends on the off times regardless of responses.",
+                   UintegerValue(0),
+                   MakeUintegerAccessor(&MyOnOffApplication::m_outstanding),
+                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute("ThinkTime", "A RandomVariableStream used to pick the time [us] between a response and the next request in closed loop.",
+                   StringValue("ns3::ConstantRandomVariable[Constant=0]"),
+                   MakePointerAccessor(&MyOnOffApplication::m_thinkTime),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute("Replay", "Send the requests of a trace (see MyTraceReplayer) instead of the off times.",
+                   BooleanValue(false),
+                   MakeBooleanAccessor(&MyOnOffApplication::m_replay),
+                   MakeBooleanChecker())
     .AddAttribute("MaxBytes", 
                    "The total number of bytes to send. Once these bytes are sent, "
                    "no packet is sent again, even in on state. The value zero means "
@@ -89,6 +176,10 @@ MyOnOffApplication::GetTypeId(void)
                      "A packet has been received",
                      MakeTraceSourceAccessor (&MyOnOffApplication::m_rxTrace),
                      "ns3::Packet::AddressTracedCallback")
+    .AddTraceSource("Rtt",
+                     "The round-trip time of a request in closed loop",
+                     MakeTraceSourceAccessor (&MyOnOffApplication::m_rttTrace),
+                     "ns3::Time::TracedCallback")
   ;
   return tid;
 }
@@ -102,9 +193,20 @@ MyOnOffApplication::MyOnOffApplication()
     m_totBytes(0),
     m_totalRx(0),
     m_clientAddress(Ipv4Address()),
-    m_totalPacket(0)
+    m_totalPacket(0),
+    m_current(0),
+    m_outstanding(0),
+    m_lastRequest(0),
+    m_stopped(false),
+    m_replay(false),
+    m_requestSize(0),
+    m_requestKey(-1),
+    m_arrival(ARRIVAL_OFF_TIME),
+    m_burstInterval(0)
 {
   NS_LOG_FUNCTION(this);
+  m_arrivalRng = CreateObject<UniformRandomVariable>();
+  m_burstRng = CreateObject<UniformRandomVariable>();
 }
 
 MyOnOffApplication::~MyOnOffApplication()
@@ -132,7 +234,15 @@ MyOnOffApplication::AssignStreams(int64_t stream)
 {
   NS_LOG_FUNCTION(this << stream);
   m_offTime->SetStream(stream + 1);
-  return 2;
+  if(m_key){
+    m_key->SetStream(stream + 2);
+  }
+  m_thinkTime->SetStream(stream + 3);
+  m_arrivalRng->SetStream(stream + 4);
+  if(m_size){
+    m_size->SetStream(stream + 5);
+  }
+  return 6;
 }
 
 void
@@ -180,13 +290,28 @@ MyOnOffApplication::StartApplication() // Called at time specified by Start
 
   m_cbrRateFailSafe = m_cbrRate;
 
+  if(m_arrival==ARRIVAL_MMPP){
+    m_means = ParseList(m_mmppMeans);
+    m_dwell = ParseList(m_mmppDwell);
+    NS_ABORT_MSG_IF(m_means.empty() || m_means.size()!=m_dwell.size(), "MyOnOffApplication >> MmppMeans and MmppDwell need one value per state");
+    NS_ABORT_MSG_IF(*std::max_element(m_means.begin(), m_means.end())<=0, "MyOnOffApplication >> no state of the MMPP sends requests");
+    NS_ABORT_MSG_IF(*std::min_element(m_dwell.begin(), m_dwell.end())<=0, "MyOnOffApplication >> MmppDwell must be positive");
+  }
+  NS_ABORT_MSG_IF(m_arrival==ARRIVAL_PARETO && (m_paretoShape<=1 || m_paretoInterval<=0),
+                  "MyOnOffApplication >> the Pareto process needs ParetoShape > 1 and ParetoInterval > 0");
+  if(m_burstInterval>0){
+    m_burstRng->SetStream(BURST_STREAM+m_burstGroup);
+    ScheduleBurst();
+  }
 }
 
 void MyOnOffApplication::StopApplication() // Called at time specified by Stop
 {
   NS_LOG_FUNCTION(this);
 
+  m_stopped = true;
   CancelEvents();
+  Simulator::Cancel(m_burstEvent);
   if(m_socket != 0)
     {
       m_socket->Close();
@@ -258,9 +383,208 @@ void MyOnOffApplication::ScheduleStartEvent()
 {  // Schedules the event to start sending data(switch to the "On" state)
   NS_LOG_FUNCTION(this);
 
-  Time offInterval = MicroSeconds(m_offTime->GetValue());
-  NS_LOG_LOGIC("start at " << offInterval);
-  m_startStopEvent = Simulator::Schedule(offInterval, &MyOnOffApplication::StartSending, this);
+  if(!m_logical.empty()){
+    if(m_arrivals.empty()){
+      for(uint32_t i=0; i<m_logical.size(); i++){
+        m_arrivals.push(Arrival(NextArrival(i), i));
+      }
+    }
+    // the earliest request of the group, then the next one of the same client
+    Arrival next = m_arrivals.top();
+    m_arrivals.pop();
+    m_current = next.second;
+    m_arrivals.push(Arrival(NextArrival(next.second), next.second));
+    m_startStopEvent = Simulator::Schedule(next.first-Simulator::Now(), &MyOnOffApplication::StartSending, this);
+    return;
+  }
+  Time next = NextArrival(0);
+  NS_LOG_LOGIC("start at " << next);
+  m_startStopEvent = Simulator::Schedule(next-Simulator::Now(), &MyOnOffApplication::StartSending, this);
+}
+
+Time MyOnOffApplication::NextArrival(uint32_t client)
+{
+  if(client>=m_process.size()){
+    m_process.resize(client+1);
+  }
+  ArrivalState& s = m_process[client];
+  if(!s.started){
+    s.started = true;
+    s.last = Simulator::Now();
+    if(m_arrival==ARRIVAL_MMPP){
+      s.stateEnd = s.last+MicroSeconds(Exponential(m_dwell[0]));
+    }
+    else if(m_arrival==ARRIVAL_PARETO){
+      // every source starts with an off period
+      for(uint32_t i=0; i<m_paretoSources; i++){
+        ParetoSource source;
+        source.next = s.last+MicroSeconds(Pareto(m_paretoOff));
+        source.onEnd = source.next+MicroSeconds(Pareto(m_paretoOn));
+        s.sources.push_back(source);
+      }
+    }
+  }
+  switch(m_arrival){
+  case ARRIVAL_MMPP:
+    while(true){
+      if(m_means[s.state]>0){
+        Time next = s.last+MicroSeconds(Exponential(m_means[s.state]));
+        if(next<=s.stateEnd){
+          s.last = next;
+          break;
+        }
+      }
+      // memoryless, so the next state draws from the end of this one
+      s.last = s.stateEnd;
+      s.state = (s.state+1)%m_means.size();
+      s.stateEnd = s.last+MicroSeconds(Exponential(m_dwell[s.state]));
+    }
+    break;
+  case ARRIVAL_PARETO:{
+    auto source = std::min_element(s.sources.begin(), s.sources.end(),
+                                   [](const ParetoSource& a, const ParetoSource& b){ return a.next<b.next; });
+    s.last = source->next;
+    source->next += MicroSeconds(m_paretoInterval);
+    if(source->next>=source->onEnd){
+      source->next = source->onEnd+MicroSeconds(Pareto(m_paretoOff));
+      source->onEnd = source->next+MicroSeconds(Pareto(m_paretoOn));
+    }
+    break;
+  }
+  default:
+    s.last += MicroSeconds(m_offTime->GetValue());
+  }
+  return s.last;
+}
+
+double MyOnOffApplication::Exponential(double mean)
+{
+  return -mean*std::log(1-m_arrivalRng->GetValue());
+}
+
+double MyOnOffApplication::Pareto(double mean)
+{
+  double scale = mean*(m_paretoShape-1)/m_paretoShape;
+  return scale/std::pow(1-m_arrivalRng->GetValue(), 1/m_paretoShape);
+}
+
+// the mean of the distributions of ns-3 with a closed form, bounds are ignored
+static double
+GetMean(Ptr<RandomVariableStream> rv)
+{
+  if(Ptr<ExponentialRandomVariable> exponential = DynamicCast<ExponentialRandomVariable>(rv)){
+    return exponential->GetMean();
+  }
+  if(Ptr<ConstantRandomVariable> constant = DynamicCast<ConstantRandomVariable>(rv)){
+    return constant->GetConstant();
+  }
+  if(Ptr<UniformRandomVariable> uniform = DynamicCast<UniformRandomVariable>(rv)){
+    return (uniform->GetMin()+uniform->GetMax())/2;
+  }
+  if(Ptr<ParetoRandomVariable> pareto = DynamicCast<ParetoRandomVariable>(rv)){
+    NS_ABORT_MSG_IF(pareto->GetShape()<=1, "MyOnOffApplication >> a Pareto OffTime of shape "<<pareto->GetShape()<<" has no finite mean");
+    return pareto->GetMean();
+  }
+  if(Ptr<NormalRandomVariable> normal = DynamicCast<NormalRandomVariable>(rv)){
+    return normal->GetMean();
+  }
+  if(Ptr<LogNormalRandomVariable> logNormal = DynamicCast<LogNormalRandomVariable>(rv)){
+    return std::exp(logNormal->GetMu()+logNormal->GetSigma()*logNormal->GetSigma()/2);
+  }
+  if(Ptr<GammaRandomVariable> gamma = DynamicCast<GammaRandomVariable>(rv)){
+    return gamma->GetAlpha()*gamma->GetBeta();
+  }
+  if(Ptr<ErlangRandomVariable> erlang = DynamicCast<ErlangRandomVariable>(rv)){
+    // the sum of K exponentials of mean Lambda
+    return erlang->GetK()*erlang->GetLambda();
+  }
+  if(Ptr<WeibullRandomVariable> weibull = DynamicCast<WeibullRandomVariable>(rv)){
+    return weibull->GetScale()*std::tgamma(1+1/weibull->GetShape());
+  }
+  if(Ptr<TriangularRandomVariable> triangular = DynamicCast<TriangularRandomVariable>(rv)){
+    return triangular->GetMean();
+  }
+  NS_ABORT_MSG("MyOnOffApplication >> the mean of an OffTime of "<<rv->GetInstanceTypeId().GetName()
+               <<" is unknown, use a distribution with a closed-form mean to predict the rate");
+  return 0;
+}
+
+double MyOnOffApplication::GetMeanRate() const
+{
+  if(m_outstanding>0 || m_replay){
+    return 0;
+  }
+  double rate = 0;  // [1/us]
+  switch(m_arrival){
+  case ARRIVAL_MMPP:{
+    // a cycle of the states brings dwell/mean requests in each of them
+    std::vector<double> means = ParseList(m_mmppMeans);
+    std::vector<double> dwell = ParseList(m_mmppDwell);
+    if(means.empty() || means.size()!=dwell.size()){
+      return 0;
+    }
+    double cycle = 0;
+    double requests = 0;
+    for(size_t i=0; i<means.size(); i++){
+      cycle += dwell[i];
+      if(means[i]>0){
+        requests += dwell[i]/means[i];
+      }
+    }
+    if(cycle<=0){
+      return 0;
+    }
+    rate = requests/cycle;
+    break;
+  }
+  case ARRIVAL_PARETO:
+    if(m_paretoInterval<=0 || m_paretoOn+m_paretoOff<=0){
+      return 0;
+    }
+    rate = m_paretoSources*m_paretoOn/(m_paretoOn+m_paretoOff)/m_paretoInterval;
+    break;
+  default:{
+    double mean = GetMean(m_offTime);
+    if(mean<=0){
+      return 0;
+    }
+    rate = 1/mean;
+  }
+  }
+  if(m_burstInterval>0){
+    rate += std::max(m_burstSize, 1.0)/m_burstInterval;
+  }
+  return rate*1000000;
+}
+
+void MyOnOffApplication::ScheduleBurst()
+{
+  double interval = -m_burstInterval*std::log(1-m_burstRng->GetValue());
+  m_burstEvent = Simulator::Schedule(MicroSeconds(interval), &MyOnOffApplication::Burst, this);
+}
+
+void MyOnOffApplication::Burst()
+{
+  NS_LOG_FUNCTION(this);
+  // geometric with mean BurstSize, drawn by every client of the group alike
+  double u = m_burstRng->GetValue();
+  uint32_t n = 1;
+  if(m_burstSize>1){
+    n += std::floor(std::log(1-u)/std::log(1-1/m_burstSize));
+  }
+  if(m_connected && !m_stopped){
+    NS_LOG_DEBUG("HttpClient (" << m_clientAddress << ") >> burst of " << n << " requests of group " << m_burstGroup);
+    uint32_t current = m_current;
+    uint32_t nClients = m_logical.empty() ? 1 : m_logical.size();
+    for(uint32_t i=0; i<nClients; i++){
+      for(uint32_t k=0; k<n; k++){
+        m_current = i;
+        SendPacket();
+      }
+    }
+    m_current = current;
+  }
+  ScheduleBurst();
 }
 
 void MyOnOffApplication::SendPacket()
@@ -269,12 +593,16 @@ void MyOnOffApplication::SendPacket()
 
   NS_ASSERT(m_sendEvent.IsExpired());
   m_totalPacket++;
-  Ptr<Packet> packet = CreatePacket(m_pktSize, m_actuator);
+  uint32_t size = m_requestSize;
+  if(size==0){
+    size = m_size ? m_size->GetInteger() : m_pktSize;
+  }
+  Ptr<Packet> packet = CreatePacket(size, m_actuator);
   m_txTrace(packet);
   int sendSize = m_socket->Send(packet);
   NS_LOG_DEBUG("HttpClient (" << m_clientAddress << ") >> Sending request for "
               << "server (" << InetSocketAddress::ConvertFrom(m_peer).GetIpv4() << ") size: "<<sendSize << ".");
-  m_totBytes += m_pktSize;
+  m_totBytes += packet->GetSize();
   m_lastStartTime = Simulator::Now();
   m_residualBits = 0;
   if(m_bulksend==true){
@@ -287,6 +615,44 @@ void MyOnOffApplication::SetSocket(Ptr<Socket> socket)
   m_socket = socket;
 }
 
+void MyOnOffApplication::AddLogicalClient(Ipv4Address address, Address actuator)
+{
+  NS_LOG_FUNCTION(this << address);
+  LogicalClient client;
+  client.address = address;
+  client.actuator = actuator;
+  client.total = 0;
+  m_logical.push_back(client);
+}
+
+void MyOnOffApplication::SetRemote(Address peer)
+{
+  NS_LOG_FUNCTION(this << peer);
+  m_peer = peer;
+  if(!m_socket){
+    return;
+  }
+  Ptr<Socket> oldSocket = m_socket;
+  m_socket = Socket::CreateSocket(GetNode(), m_tid);
+  if(m_socket->Bind() == -1)
+  {
+    NS_FATAL_ERROR("Failed to bind socket");
+  }
+  // TCP buffers the requests sent before the handshake completes
+  m_socket->Connect(m_peer);
+  m_socket->SetConnectCallback(
+    MakeCallback(&MyOnOffApplication::ReconnectionSucceeded, this),
+    MakeCallback(&MyOnOffApplication::ConnectionFailed, this));
+  NS_LOG_DEBUG("HttpClient (" << m_clientAddress << ") >> switch to server (" << InetSocketAddress::ConvertFrom(m_peer).GetIpv4() << ")");
+  oldSocket->Close();
+}
+
+void MyOnOffApplication::ReconnectionSucceeded(Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION(this << socket);
+  socket->SetRecvCallback(MakeCallback (&MyOnOffApplication::HandleReceive, this));
+}
+
 void MyOnOffApplication::ConnectionSucceeded(Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION(this << socket);
@@ -295,9 +661,88 @@ void MyOnOffApplication::ConnectionSucceeded(Ptr<Socket> socket)
   m_connected = true;
   socket->SetRecvCallback(MakeCallback (&MyOnOffApplication::HandleReceive, this));
   CancelEvents();
+  if(m_replay){
+    std::vector<std::pair<uint32_t, int>> backlog;
+    backlog.swap(m_replayBacklog);
+    for(auto& request: backlog){
+      SendRequest(request.first, request.second);
+    }
+    return;
+  }
+  if(m_outstanding>0){
+    StartClosedLoop();
+    return;
+  }
   ScheduleStartEvent();
 }
 
+bool MyOnOffApplication::SendRequest(uint32_t size, int key)
+{
+  NS_LOG_FUNCTION(this << size << key);
+  if(m_stopped){
+    NS_LOG_DEBUG("HttpClient (" << m_clientAddress << ") >> stopped, request of the trace dropped");
+    return false;
+  }
+  if(!m_connected){
+    m_replayBacklog.push_back(std::make_pair(size, key));
+    return true;
+  }
+  m_requestSize = size;
+  m_requestKey = key;
+  SendPacket();
+  m_requestSize = 0;
+  m_requestKey = -1;
+  return true;
+}
+
+void MyOnOffApplication::StartClosedLoop()
+{
+  NS_LOG_FUNCTION(this);
+  // every client starts its requests after an off time, as in open loop
+  uint32_t nClients = m_logical.empty() ? 1 : m_logical.size();
+  for(uint32_t i=0; i<nClients; i++){
+    for(uint32_t k=0; k<m_outstanding; k++){
+      Simulator::Schedule(MicroSeconds(m_offTime->GetValue()), &MyOnOffApplication::SendClosedLoop, this, i);
+    }
+  }
+}
+
+void MyOnOffApplication::SendClosedLoop(uint32_t client)
+{
+  NS_LOG_FUNCTION(this << client);
+  if(m_stopped){
+    return;
+  }
+  m_current = client;
+  SendPacket();
+  m_pending[m_lastRequest] = Pending{Simulator::Now(), client};
+}
+
+void MyOnOffApplication::ResponseReceived(Ptr<const Packet> packet, const Address& from)
+{
+  NS_LOG_FUNCTION(this << packet);
+  if(m_outstanding==0){
+    return;
+  }
+  for(auto id: MyMetrics::GetRequestIds(packet)){
+    auto itr = m_pending.find(id);
+    if(itr==m_pending.end()){
+      continue;
+    }
+    Time rtt = Simulator::Now()-itr->second.sent;
+    m_rtt.Record(rtt);
+    m_rttTrace(rtt);
+    NS_LOG_DEBUG("HttpClient (" << m_clientAddress << ") >> response after " << rtt.GetMicroSeconds() << "us");
+    Simulator::Schedule(MicroSeconds(m_thinkTime->GetValue()), &MyOnOffApplication::SendClosedLoop, this, itr->second.client);
+    m_pending.erase(itr);
+  }
+}
+
+const MyLatencyHistogram& MyOnOffApplication::GetRtt() const
+{
+  return m_rtt;
+}
+
 void MyOnOffApplication::ConnectionFailed(Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION(this << socket);
@@ -323,21 +768,29 @@ void MyOnOffApplication::HandleReceive (Ptr<Socket> socket)
       buff[from]->AddAtEnd(packet);
     }
     NS_LOG_DEBUG("from " << InetSocketAddress::ConvertFrom(from).GetIpv4() << " size " << buff[from]->GetSize());
-    if(buff[from]->GetSize()>=m_pktSize){
-      m_rxTrace (buff[from]->CreateFragment(0,m_pktSize), from);
-      buff[from]->RemoveAtStart(m_pktSize);
+    Ptr<Packet> frame;
+    while(MyMessage::Pop(buff[from], frame)){
+      m_rxTrace (frame, from);
     }
   }
 }
 
 Ptr<Packet> MyOnOffApplication::CreatePacket(uint32_t pktSize, Address peer){
-  Ptr<Packet> packet = Create<Packet>((uint8_t*)CreateData(peer).c_str(),pktSize);
-  return packet;
+  return MyMessage::CreateFrame(CreateData(peer), pktSize);
 }
 
 std::string MyOnOffApplication::CreateData(Address addr){
+  Ipv4Address source = m_clientAddress;
+  int total = m_totalPacket;
+  if(!m_logical.empty()){
+    LogicalClient& client = m_logical[m_current];
+    client.total++;
+    source = client.address;
+    total = client.total;
+  }
+  m_lastRequest = (static_cast<uint64_t>(source.Get())<<32) | static_cast<uint32_t>(total);
   std::stringstream nAddr;
-  nAddr << m_clientAddress;
+  nAddr << source;
   std::stringstream aAddr;
   aAddr << InetSocketAddress::ConvertFrom(addr).GetIpv4();
   int aPort = InetSocketAddress::ConvertFrom(addr).GetPort();
@@ -347,12 +800,29 @@ std::string MyOnOffApplication::CreateData(Address addr){
     {"Port", aPort},
   });
   
-  json11::Json obj = json11::Json::object({
+  json11::Json::object obj({
     {"NodeId", nodeId},
     {"ActuatorId", actId},
-    {"Total", m_totalPacket},
+    {"Total", total},
+    {"Id", MyMessage::FormatRequestId(m_lastRequest)},
+    {"Created", static_cast<double>(Simulator::Now().GetNanoSeconds())},
   });
-  return obj.dump();
+  if(m_requestKey>=0){
+    obj["Key"] = m_requestKey;
+  }
+  else if(m_key){
+    obj["Key"] = static_cast<int>(m_key->GetInteger());
+  }
+  if(!m_logical.empty()){
+    InetSocketAddress logical = InetSocketAddress::ConvertFrom(m_logical[m_current].actuator);
+    std::stringstream lAddr;
+    lAddr << logical.GetIpv4();
+    obj["LogicalActuator"] = json11::Json::object({
+      {"Address", lAddr.str()},
+      {"Port", logical.GetPort()},
+    });
+  }
+  return json11::Json(obj).dump();
 }
 
 }
@@ -2,25 +2,45 @@
 #ifndef MY_ONOFF_APPLICATION_H
 #define MY_ONOFF_APPLICATION_H
 
+#include <functional>
 #include <map>
+#include <queue>
+#include <unordered_map>
+#include <vector>
 #include "ns3/address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
+#include "ns3/packet.h"
+#include "ns3/my-metrics.h"
 
 
 namespace ns3 {
 
 class Address;
 class RandomVariableStream;
+class UniformRandomVariable;
 class Socket;
 
 
 class MyOnOffApplication : public Application 
 {
 public:
+  /**
+   * The process of the request arrivals of a client.
+   * All times are in microseconds, as OffTime.
+   */
+  enum ArrivalProcess
+  {
+    ARRIVAL_OFF_TIME,   //!< one OffTime between requests
+    ARRIVAL_MMPP,       //!< Poisson with the mean of the current state of a cyclic Markov chain
+    ARRIVAL_PARETO,     //!< superposed on/off sources with Pareto on and off times (self-similar)
+  };
+
   static TypeId GetTypeId(void);
 
   MyOnOffApplication();
@@ -35,6 +55,51 @@ public:
 
   void SetSocket(Ptr<Socket> socket);
 
+  /**
+   * Send the following requests to another server.
+   * The arrival process goes on, and the old connection is closed
+   * after its pending data has been sent.
+   */
+  void SetRemote(Address peer);
+
+  /**
+   * Send the superposed requests of a group of clients instead of one.
+   * Every logical client draws its own off times, and its requests carry its
+   * address, sequence numbers and actuator (as "LogicalActuator"), while the responses
+   * come back to the actuator of this application.
+   * \param address the address of the logical client
+   * \param actuator its actuator
+   */
+  void AddLogicalClient(Ipv4Address address, Address actuator);
+
+  /**
+   * A response for this client arrived at its actuator. In closed loop
+   * (Outstanding > 0) the round-trip time is recorded and the next request
+   * is sent after the think time.
+   */
+  void ResponseReceived(Ptr<const Packet> packet, const Address& from);
+  /**
+   * \return round-trip times of the closed loop
+   */
+  const MyLatencyHistogram& GetRtt() const;
+  /**
+   * The long-run mean of the open-loop arrival process, bursts included,
+   * from the attributes alone, so it is known before the client starts.
+   * An OffTime without a closed-form mean (e.g. empirical) is rejected.
+   * \return requests per second of a (logical) client, 0 if it depends on
+   *         the responses (Outstanding > 0) or on a trace (Replay)
+   */
+  double GetMeanRate() const;
+
+  /**
+   * Send a request now, for a client driven by a trace (Replay is true).
+   * A request due before the connection is up is sent once it is.
+   * \param size the size of the request in the trace [bytes]
+   * \param key the key of the request, or -1 to draw it from Key
+   * \return false if the request is dropped, as the client has stopped
+   */
+  bool SendRequest(uint32_t size, int key);
+
 protected:
   virtual void DoDispose(void);
 private:
@@ -52,6 +117,7 @@ private:
   bool            m_connected;    //!< True if connected
   Ptr<RandomVariableStream>  m_onTime;       //!< rng for On Time
   Ptr<RandomVariableStream>  m_offTime;      //!< rng for Off Time
+  Ptr<RandomVariableStream>  m_key;          //!< rng for request key (optional)
   DataRate        m_cbrRate;      //!< Rate that data is generated
   DataRate        m_cbrRateFailSafe;      //!< Rate that data is generated (check copy)
   uint32_t        m_pktSize;      //!< Size of packets
@@ -72,6 +138,77 @@ private:
 
   int m_totalPacket;
 
+  struct LogicalClient
+  {
+    Ipv4Address address;
+    Address actuator;
+    int total;
+  };
+  std::vector<LogicalClient> m_logical;
+  typedef std::pair<Time, uint32_t> Arrival;   //!< next request of a logical client
+  std::priority_queue<Arrival, std::vector<Arrival>, std::greater<Arrival>> m_arrivals;
+  uint32_t m_current;   //!< the logical client of the next request
+
+  // closed loop
+  struct Pending
+  {
+    Time sent;
+    uint32_t client;
+  };
+  uint32_t m_outstanding;                 //!< requests in flight per client, 0 for open loop
+  Ptr<RandomVariableStream> m_thinkTime;  //!< [us] after a response
+  std::unordered_map<uint64_t, Pending> m_pending;
+  uint64_t m_lastRequest;                 //!< id of the request created last
+  bool m_stopped;
+  MyLatencyHistogram m_rtt;
+  TracedCallback<Time> m_rttTrace;
+  bool m_replay;          //!< requests are sent by SendRequest only
+  uint32_t m_requestSize; //!< size of the next request in the trace, 0 if none
+  int m_requestKey;
+  std::vector<std::pair<uint32_t, int>> m_replayBacklog; //!< requests of the trace due before the connection
+  void StartClosedLoop();
+  void SendClosedLoop(uint32_t client);
+
+  // arrival processes
+  struct ParetoSource
+  {
+    Time next;    //!< next request
+    Time onEnd;   //!< end of the on period
+  };
+  struct ArrivalState
+  {
+    bool started = false;
+    Time last;          //!< last request
+    uint32_t state = 0; //!< state of the MMPP
+    Time stateEnd;
+    std::vector<ParetoSource> sources;
+  };
+  ArrivalProcess m_arrival;
+  std::string m_mmppMeans;          //!< mean time between requests per state, "-" separated
+  std::string m_mmppDwell;          //!< mean time in each state, "-" separated
+  std::vector<double> m_means;
+  std::vector<double> m_dwell;
+  uint32_t m_paretoSources;
+  double m_paretoShape;
+  double m_paretoOn;                //!< mean on period
+  double m_paretoOff;               //!< mean off period
+  double m_paretoInterval;          //!< time between the requests of an on source
+  Ptr<UniformRandomVariable> m_arrivalRng;
+  std::vector<ArrivalState> m_process;  //!< per logical client, or one
+  Ptr<RandomVariableStream> m_size; //!< rng for request size [bytes] (optional)
+  Time NextArrival(uint32_t client);
+  double Exponential(double mean);
+  double Pareto(double mean);
+
+  // group bursts
+  double m_burstInterval;           //!< mean time between bursts, 0 disables
+  double m_burstSize;               //!< mean number of requests per client in a burst
+  uint32_t m_burstGroup;
+  Ptr<UniformRandomVariable> m_burstRng;
+  EventId m_burstEvent;
+  void ScheduleBurst();
+  void Burst();
+
   Ptr<Packet> CreatePacket(uint32_t pktSize, Address peer);
 
   /// Traced Callback: transmitted packets.
@@ -86,6 +223,7 @@ private:
   void ScheduleStartEvent();
   void ConnectionSucceeded(Ptr<Socket> socket);
   void ConnectionFailed(Ptr<Socket> socket);
+  void ReconnectionSucceeded(Ptr<Socket> socket);
   void HandleReceive(Ptr<Socket> socket);
 };
 
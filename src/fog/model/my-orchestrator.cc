@@ -17,15 +17,19 @@
 // Implement an object to create a star topology.
 
 #include <cmath>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 #include <cmath>
+#include <set>
 
 // ns3 includes
 #include "ns3/log.h"
 #include "ns3/constant-position-mobility-model.h"
 #include "ns3/node-list.h"
 #include "ns3/point-to-point-net-device.h"
+#include "ns3/csma-net-device.h"
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
@@ -35,23 +39,24 @@
 #include "ns3/my-onoff-application-helper.h"
 #include "ns3/my-receive-server-helper.h"
 #include "ns3/my-tree.h"
+#include "ns3/my-queueing.h"
+#include "ns3/my-metrics.h"
+#include "ns3/my-trace-writer.h"
+#include "ns3/mpi-interface.h"
 #include "ns3/json.h"
+#include "ns3/my-message.h"
 #include "my-orchestrator.h"
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("MyOrchestrator");
 
+static const uint32_t PORTS_PER_SERVICE = 3;  //!< service, load and state ports
+
 static void
 RxTracer(Ptr<OutputStreamWrapper> stream, Ptr<const Packet> packet, const Address& address)
 {
-  std::string err;
-  uint8_t buf[5120];
-  packet->CopyData(buf, 5120);
-  std::stringstream text;
-  text << buf;
-  //NS_LOG_DEBUG(text.str());
-  auto json = json11::Json::parse(text.str(), err);
+  auto json = MyMessage::Parse(packet);
   int total = json["Total"].int_value();
   *stream->GetStream() << InetSocketAddress::ConvertFrom(address).GetIpv4() << " " << Simulator::Now().GetNanoSeconds() << " " << packet->GetSize() << " " << total << std::endl;
 }
@@ -59,13 +64,7 @@ RxTracer(Ptr<OutputStreamWrapper> stream, Ptr<const Packet> packet, const Addres
 static void
 TxTracer(Ptr<OutputStreamWrapper> stream, Ptr<const Packet> packet)
 {
-  std::string err;
-  uint8_t buf[5120];
-  packet->CopyData(buf, 5120);
-  std::stringstream text;
-  text << buf;
-  //NS_LOG_DEBUG(text.str());
-  auto json = json11::Json::parse(text.str(), err);
+  auto json = MyMessage::Parse(packet);
   int total = json["Total"].int_value();
   *stream->GetStream() << Simulator::Now().GetNanoSeconds() << " " << packet->GetSize() << " " << total << std::endl;
 }
@@ -78,6 +77,111 @@ QueueTracer(Ptr<OutputStreamWrapper> stream, uint32_t packetsInQueueOld, uint32_
   }
 }
 
+static void
+MetricsRequest(Ptr<MyMetrics> metrics, uint32_t group, Ptr<const Packet> packet)
+{
+  metrics->RequestSent(group, packet);
+}
+
+static void
+MetricsResponse(Ptr<MyMetrics> metrics, uint32_t group, Ptr<const Packet> packet, const Address& address)
+{
+  metrics->ResponseReceived(group, packet);
+}
+
+static void
+MetricsStageRx(Ptr<MyMetrics> metrics, uint32_t stage, Ptr<const Packet> packet, const Address& address)
+{
+  metrics->StageReceived(stage, packet);
+}
+
+static void
+MetricsStageTx(Ptr<MyMetrics> metrics, uint32_t stage, uint32_t group, Ptr<const Packet> packet)
+{
+  metrics->StageSent(stage, group, packet);
+}
+
+static void
+MetricsBreakdown(Ptr<MyMetrics> metrics, uint64_t id, const Time& created, const std::vector<MyHop>& hops)
+{
+  metrics->Breakdown(id, created, hops);
+}
+
+static void
+MetricsQueue(Ptr<MyMetrics> metrics, uint32_t layer, uint32_t group, uint32_t packetsInQueueOld, uint32_t packetsInQueueNew)
+{
+  metrics->QueueChanged(layer, group, packetsInQueueOld, packetsInQueueNew);
+}
+
+static void
+WriteRequests(Ptr<MyTraceWriter> writer, MyTraceWriter::Kind kind, uint32_t node, Ptr<const Packet> packet)
+{
+  for(auto id: MyMetrics::GetRequestIds(packet)){
+    writer->Write(kind, node, id, packet->GetSize(), static_cast<uint32_t>(id));
+  }
+}
+
+static void
+BinaryClientTx(Ptr<MyTraceWriter> writer, uint32_t node, Ptr<const Packet> packet)
+{
+  WriteRequests(writer, MyTraceWriter::CLIENT_TX, node, packet);
+}
+
+static void
+BinaryClientRx(Ptr<MyTraceWriter> writer, uint32_t node, Ptr<const Packet> packet, const Address& address)
+{
+  WriteRequests(writer, MyTraceWriter::CLIENT_RX, node, packet);
+}
+
+static void
+BinaryServerRx(Ptr<MyTraceWriter> writer, uint32_t node, Ptr<const Packet> packet, const Address& address)
+{
+  WriteRequests(writer, MyTraceWriter::SERVER_RX, node, packet);
+}
+
+static void
+BinaryServerTx(Ptr<MyTraceWriter> writer, uint32_t node, Ptr<const Packet> packet)
+{
+  WriteRequests(writer, MyTraceWriter::SERVER_TX, node, packet);
+}
+
+static void
+BinaryQueue(Ptr<MyTraceWriter> writer, uint32_t node, uint32_t packetsInQueueOld, uint32_t packetsInQueueNew)
+{
+  if(packetsInQueueOld<packetsInQueueNew){
+    writer->Write(MyTraceWriter::QUEUE, node, 0, 0, packetsInQueueNew);
+  }
+}
+
+// the queue of a point-to-point or a shared channel device, or 0
+static Ptr<Queue<Packet>>
+GetDeviceQueue(Ptr<NetDevice> device)
+{
+  Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice>(device);
+  if(p2p){
+    return p2p->GetQueue();
+  }
+  Ptr<CsmaNetDevice> csma = DynamicCast<CsmaNetDevice>(device);
+  return csma ? csma->GetQueue() : nullptr;
+}
+
+static void
+ConnectQueues(Ptr<Node> node, const CallbackBase& cb)
+{
+  for(uint32_t d=0; d<node->GetNDevices(); d++){
+    Ptr<Queue<Packet>> queue = GetDeviceQueue(node->GetDevice(d));
+    if(queue){
+      queue->TraceConnectWithoutContext("PacketsInQueue", cb);
+    }
+  }
+}
+
+// a request is identified by its client and sequence number
+static uint64_t
+RequestId(Ptr<const Packet> packet)
+{
+  return MyMessage::GetRequestId(MyMessage::Parse(packet));
+}
 
 MyOrchestrator::MyOrchestrator(PointToPointTreeHelper p2pHelper)
   : m_simTime(180),
@@ -87,7 +191,26 @@ MyOrchestrator::MyOrchestrator(PointToPointTreeHelper p2pHelper)
     m_clientOffTime("ns3::ExponentialRandomVariable[Mean=1]"),
     m_clientPktSize(5120),
     m_clientDataRate("1Mb/s"),
-    m_firstServer(0)
+    m_clientOutstanding(0),
+    m_clientThinkTime("ns3::ConstantRandomVariable[Constant=0]"),
+    m_firstServer(0),
+    m_isMigrating(false),
+    m_migratingServer(0),
+    m_migratingTo(0),
+    m_stateRx(0),
+    m_stateTotal(0),
+    m_searchPlacement(false),
+    m_applyPlacement(false),
+    m_reportLatency(false),
+    m_predicted(0),
+    m_latencySum(0),
+    m_nLatency(0),
+    m_binaryTrace(false),
+    m_binaryThreaded(false),
+    m_traceAll(false),
+    m_sampleRate(1),
+    m_aggregateClients(false),
+    m_stream(0)
 {
   m_p2pHelper = p2pHelper;
   for(size_t i=0;i<p2pHelper.GetNLayers();i++){
@@ -105,8 +228,9 @@ void MyOrchestrator::Assign(){
 }
 
 uint32_t MyOrchestrator::AddServerHelper(std::vector<double> meanCalctime, Ipv4Address allowAddress){
-  MyTcpServerHelper myTcpServerHelper(m_protocol, m_clientPktSize, meanCalctime[0], InetSocketAddress(allowAddress,m_sinkPort+m_currentServerNum));
+  MyTcpServerHelper myTcpServerHelper(m_protocol, meanCalctime[0], InetSocketAddress(allowAddress,m_sinkPort+m_currentServerNum));
   m_serverHelper[m_currentServerNum] = myTcpServerHelper;
+  m_allowAddress[m_currentServerNum] = allowAddress;
   m_process.push_back(meanCalctime);
   m_currentServerNum++;
   return m_currentServerNum-1;
@@ -140,84 +264,248 @@ void MyOrchestrator::AssignClient(){
   MyOnOffHelper clientHelper(m_protocol, Address());
   clientHelper.SetAttribute("OffTime", StringValue(m_clientOffTime));
   clientHelper.SetAttribute("PacketSize", UintegerValue(m_clientPktSize));
-  MyReceiveServerHelper serverHelper(m_protocol, m_clientPktSize, InetSocketAddress(Ipv4Address::GetAny(), m_sinkPort));
+  if(!m_clientKey.empty()){
+    clientHelper.SetAttribute("Key", StringValue(m_clientKey));
+  }
+  clientHelper.SetAttribute("Outstanding", UintegerValue(m_clientOutstanding));
+  clientHelper.SetAttribute("ThinkTime", StringValue(m_clientThinkTime));
+  for(auto& attribute: m_clientAttributes){
+    clientHelper.SetAttribute(attribute.first, *attribute.second);
+  }
+  if(!m_clientTrace.empty()){
+    NS_ABORT_MSG_IF(m_aggregateClients, "MyOrchestrator >> a trace can not be replayed by aggregate clients");
+    clientHelper.SetAttribute("Replay", BooleanValue(true));
+    uint32_t nLeaves = 0;
+    for(size_t i=0;i<m_p2pHelper.GetNGroups(m_p2pHelper.GetNLayers()-1);i++){
+      nLeaves += m_p2pHelper.GetNNodes(m_p2pHelper.GetNLayers()-1,i);
+    }
+    m_replayer = Create<MyTraceReplayer>(m_clientTrace, nLeaves);
+  }
+  MyReceiveServerHelper serverHelper(m_protocol, InetSocketAddress(Ipv4Address::GetAny(), m_sinkPort));
 
   for(size_t i=0;i<m_p2pHelper.GetNGroups(m_p2pHelper.GetNLayers()-1);i++){
-    for(size_t j=0;j<m_p2pHelper.GetNNodes(m_p2pHelper.GetNLayers()-1,i);j++){
-      NS_LOG_DEBUG(InetSocketAddress(m_p2pHelper.GetParentAddress(m_p2pHelper.GetNLayers()-1,i,j,m_firstServer), m_sinkPort).GetPort());
-      AddressValue remoteAddress(InetSocketAddress(m_p2pHelper.GetParentAddress(m_p2pHelper.GetNLayers()-1,i,j,m_firstServer), m_sinkPort));
+    // one source per group sends for all the leaves of the group, none for an empty group
+    size_t nLeaves = m_p2pHelper.GetNNodes(m_p2pHelper.GetNLayers()-1,i);
+    size_t nClients = m_aggregateClients ? std::min<size_t>(1, nLeaves) : nLeaves;
+    for(size_t j=0;j<nClients;j++){
+      if(!m_p2pHelper.IsLocal(m_p2pHelper.GetNodeId(m_p2pHelper.GetNLayers()-1,i,j))){
+        continue;
+      }
+      AddressValue remoteAddress(InetSocketAddress(m_p2pHelper.GetParentAddress(m_p2pHelper.GetNLayers()-1,i,j,m_firstServer), GetServicePort(0)));
       clientHelper.SetAttribute("Remote",remoteAddress);
       AddressValue actuator(InetSocketAddress(m_p2pHelper.GetIpv4Address(m_p2pHelper.GetNLayers()-1,i,j,1), m_sinkPort));
       clientHelper.SetAttribute("Actuator",actuator);
-      ApplicationContainer clientApp;
-      clientApp.Add(clientHelper.Install(m_p2pHelper.GetNode(m_p2pHelper.GetNLayers()-1,i,j)));
-      ApplicationContainer serverApp;
-      serverApp.Add(serverHelper.Install(m_p2pHelper.GetNode(m_p2pHelper.GetNLayers()-1,i,j)));
+      // the leaves of a group burst together
+      clientHelper.SetAttribute("BurstGroup", UintegerValue(i));
+      uint32_t id = m_p2pHelper.GetNodeId(m_p2pHelper.GetNLayers()-1,i,j);
+      ApplicationContainer clientApp = clientHelper.Install(NodeList::GetNode(id));
+      ApplicationContainer serverApp = serverHelper.Install(NodeList::GetNode(id));
+      m_clients[id] = DynamicCast<MyOnOffApplication>(clientApp.Get(0));
+      m_stream += m_clients[id]->AssignStreams(m_stream);
+      if(m_aggregateClients){
+        for(size_t k=0;k<m_p2pHelper.GetNNodes(m_p2pHelper.GetNLayers()-1,i);k++){
+          Ipv4Address leaf = m_p2pHelper.GetIpv4Address(m_p2pHelper.GetNLayers()-1,i,k,1);
+          m_clients[id]->AddLogicalClient(leaf, InetSocketAddress(leaf, m_sinkPort));
+        }
+      }
+      m_receivers[id] = DynamicCast<MyReceiveServer>(serverApp.Get(0));
+      m_clientApps.Add(clientApp);
+      m_receiverApps.Add(serverApp);
+      if(m_replayer){
+        // leaves in the order of the node ids
+        m_replayer->AddClient(id-m_p2pHelper.GetNodeId(m_p2pHelper.GetNLayers()-1,0,0), m_clients[id]);
+      }
+      if(m_clientOutstanding>0){
+        m_receivers[id]->TraceConnectWithoutContext("Rx", MakeCallback(&MyOnOffApplication::ResponseReceived, m_clients[id]));
+      }
+      if(m_reportLatency){
+        clientApp.Get(0)->TraceConnectWithoutContext("Tx", MakeCallback(&MyOrchestrator::LatencyTx, this));
+        serverApp.Get(0)->TraceConnectWithoutContext("Rx", MakeCallback(&MyOrchestrator::LatencyRx, this));
+      }
       clientApp.Start(Seconds(1.0));
       clientApp.Stop(Seconds(m_simTime));
       serverApp.Start(Seconds(0.1));
       serverApp.Stop(Seconds(m_simTime+10));
     }
   }
+  if(m_replayer){
+    m_replayer->Start(Seconds(1.0), Seconds(m_simTime));
+  }
 }
 
 void MyOrchestrator::AssignServer(uint32_t serverIndex, uint32_t nLayer){
+  std::map<uint32_t, Ptr<MyTcpServer>> instances = InstallServer(serverIndex, nLayer, Seconds(0.1));
+  m_serverPlace[serverIndex] = nLayer;
+  m_servers[serverIndex] = instances;
+  if(m_offload.find(serverIndex)!=m_offload.end()){
+    ConnectPeers(serverIndex, nLayer, instances);
+  }
+}
+
+std::map<uint32_t, Ptr<MyTcpServer>> MyOrchestrator::InstallServer(uint32_t serverIndex, uint32_t nLayer, Time start){
+  std::map<uint32_t, Ptr<MyTcpServer>> instances;
+  auto offload = m_offload.find(serverIndex);
+  if(offload!=m_offload.end()){
+    m_serverHelper[serverIndex].SetAttribute("OffloadThreshold", UintegerValue(offload->second.threshold));
+    m_serverHelper[serverIndex].SetAttribute("OffloadWait", TimeValue(offload->second.wait));
+    m_serverHelper[serverIndex].SetAttribute("LoadPort", UintegerValue(GetLoadPort(serverIndex)));
+    m_serverHelper[serverIndex].SetAttribute("StealThreshold", UintegerValue(offload->second.stealThreshold));
+    m_serverHelper[serverIndex].SetAttribute("StealInterval", TimeValue(offload->second.stealInterval));
+    m_serverHelper[serverIndex].SetAttribute("StealPolicy", EnumValue(offload->second.stealPolicy));
+  }
+  m_serverHelper[serverIndex].SetAttribute("Local", AddressValue(InetSocketAddress(m_allowAddress[serverIndex], GetServicePort(serverIndex))));
+  uint32_t nProcess = m_processCount[nLayer];
+  std::stringstream meanTime;
+  meanTime << "ns3::ExponentialRandomVariable[Mean=" << m_process[serverIndex][nLayer]*nProcess << "]";
+  NS_LOG_DEBUG(serverIndex<<":"<<meanTime.str());
+  m_serverHelper[serverIndex].SetAttribute("CalcTime", StringValue(meanTime.str()));
   for(size_t i=0;i<m_p2pHelper.GetNGroups(nLayer);i++){
     for(size_t j=0;j<m_p2pHelper.GetNNodes(nLayer,i);j++){
-      auto chaine = m_chaine.find(serverIndex);
-      if(chaine != m_chaine.end()){
-        std::map<Address, Address> addrTable;
-        NS_LOG_DEBUG("MyOrchestrator >> chain "<<m_chaine[serverIndex]<<" place "<<m_serverPlace[m_chaine[serverIndex]]);
-        if(m_serverPlace[m_chaine[serverIndex]]<nLayer){
-          Address nextService = InetSocketAddress(m_p2pHelper.GetParentAddress(nLayer,i,j,m_serverPlace[m_chaine[serverIndex]]),m_sinkPort+m_chaine[serverIndex]);
-          std::vector<Ipv4Address> children = m_p2pHelper.GetChildrenAddress(nLayer,i,j,m_p2pHelper.GetNLayers()-1);
-          for(Ipv4Address k: children){
-            NS_LOG_DEBUG("MyOrchestrator >> make addrTable "<<InetSocketAddress(k));
-            addrTable[InetSocketAddress(k)] = nextService;
-          }
-        }
-        else if(m_serverPlace[m_chaine[serverIndex]]==nLayer){
-          Address nextService = InetSocketAddress(m_p2pHelper.GetIpv4Address(nLayer,i,j,0),m_sinkPort+m_chaine[serverIndex]);
-          std::vector<Ipv4Address> children = m_p2pHelper.GetChildrenAddress(nLayer,i,j,m_p2pHelper.GetNLayers()-1);
-          for(Ipv4Address k: children){
-            NS_LOG_DEBUG("MyOrchestrator >> make addrTable "<<InetSocketAddress(k));
-            addrTable[InetSocketAddress(k)] = nextService;
-          }
-        }
-        else{
-          std::vector<uint32_t> nextServiceList = m_p2pHelper.GetChildrenId(nLayer,i,j,m_serverPlace[m_chaine[serverIndex]]);
-          for(uint32_t k: nextServiceList){
-            std::vector<Ipv4Address> children = m_p2pHelper.GetChildrenAddress(k, m_p2pHelper.GetNLayers()-1-m_serverPlace[m_chaine[serverIndex]]);
-            for(Ipv4Address l: children){
-              NS_LOG_DEBUG("MyOrchestrator >> make addrTable to "<<InetSocketAddress(m_p2pHelper.GetIpv4Address(k,1)).GetIpv4()<<" from "<<InetSocketAddress(l).GetIpv4());
-              addrTable[InetSocketAddress(l)] = InetSocketAddress(m_p2pHelper.GetIpv4Address(k,1),m_sinkPort+m_chaine[serverIndex]);
-            }
-          }
+      if(!m_p2pHelper.IsLocal(m_p2pHelper.GetNodeId(nLayer,i,j))){
+        continue;
+      }
+      ApplicationContainer servers = m_p2pHelper.InstallApp(m_serverHelper[serverIndex], nLayer, i, j);
+      Ptr<MyTcpServer> server = DynamicCast<MyTcpServer>(servers.Get(0));
+      m_stream += server->AssignStreams(m_stream);
+      std::map<Address, Address> addrTable = CreateAddressTable(serverIndex, nLayer, i, j);
+      NS_LOG_DEBUG("address: "<<m_p2pHelper.GetIpv4Address(nLayer,i,j,1)<<" port:"<< GetServicePort(serverIndex) <<" size: "<<addrTable.size());
+      server->SetAddressTable(addrTable);
+      instances[m_p2pHelper.GetNodeId(nLayer,i,j)] = server;
+      servers.Start(start);
+      servers.Stop(Seconds(m_simTime+5)-Simulator::Now());
+    }
+  }
+  return instances;
+}
+
+std::map<Address, Address> MyOrchestrator::CreateAddressTable(uint32_t serverIndex, uint32_t nLayer, uint32_t i, uint32_t j){
+  std::map<Address, Address> addrTable;
+  auto chaine = m_chaine.find(serverIndex);
+  if(chaine == m_chaine.end()){
+    return addrTable;
+  }
+  uint32_t next = chaine->second;
+  uint32_t nextPlace = m_serverPlace[next];
+  NS_LOG_DEBUG("MyOrchestrator >> chain "<<next<<" place "<<nextPlace);
+  if(nextPlace<nLayer){
+    Address nextService = InetSocketAddress(m_p2pHelper.GetParentAddress(nLayer,i,j,nextPlace),GetServicePort(next));
+    std::vector<Ipv4Address> children = m_p2pHelper.GetChildrenAddress(nLayer,i,j,m_p2pHelper.GetNLayers()-1);
+    for(Ipv4Address k: children){
+      NS_LOG_DEBUG("MyOrchestrator >> make addrTable "<<InetSocketAddress(k));
+      addrTable[InetSocketAddress(k)] = nextService;
+    }
+  }
+  else if(nextPlace==nLayer){
+    Address nextService = InetSocketAddress(m_p2pHelper.GetIpv4Address(nLayer,i,j,0),GetServicePort(next));
+    std::vector<Ipv4Address> children = m_p2pHelper.GetChildrenAddress(nLayer,i,j,m_p2pHelper.GetNLayers()-1);
+    for(Ipv4Address k: children){
+      NS_LOG_DEBUG("MyOrchestrator >> make addrTable "<<InetSocketAddress(k));
+      addrTable[InetSocketAddress(k)] = nextService;
+    }
+  }
+  else{
+    std::vector<uint32_t> nextServiceList = m_p2pHelper.GetChildrenId(nLayer,i,j,nextPlace);
+    for(uint32_t k: nextServiceList){
+      std::vector<Ipv4Address> children = m_p2pHelper.GetChildrenAddress(k, m_p2pHelper.GetNLayers()-1-nextPlace);
+      for(Ipv4Address l: children){
+        NS_LOG_DEBUG("MyOrchestrator >> make addrTable to "<<InetSocketAddress(m_p2pHelper.GetIpv4Address(k,1)).GetIpv4()<<" from "<<InetSocketAddress(l).GetIpv4());
+        addrTable[InetSocketAddress(l)] = InetSocketAddress(m_p2pHelper.GetIpv4Address(k,1),GetServicePort(next));
+      }
+    }
+  }
+  return addrTable;
+}
+
+void MyOrchestrator::ConnectPeers(uint32_t serverIndex, uint32_t nLayer, std::map<uint32_t, Ptr<MyTcpServer>> instances){
+  uint16_t port = GetServicePort(serverIndex);
+  uint16_t loadPort = GetLoadPort(serverIndex);
+
+  // siblings under the same parent
+  for(size_t i=0;i<m_p2pHelper.GetNGroups(nLayer);i++){
+    for(size_t j=0;j<m_p2pHelper.GetNNodes(nLayer,i);j++){
+      if(!m_p2pHelper.IsLocal(m_p2pHelper.GetNodeId(nLayer,i,j))){
+        continue;
+      }
+      Ptr<MyTcpServer> server = instances[m_p2pHelper.GetNodeId(nLayer,i,j)];
+      for(size_t k=0;k<m_p2pHelper.GetNNodes(nLayer,i);k++){
+        if(k==j){
+          continue;
         }
-        uint32_t nProcess = m_processCount[nLayer];
-        std::stringstream meanTime;
-        meanTime << "ns3::ExponentialRandomVariable[Mean=" << m_process[serverIndex][nLayer]*nProcess << "]";
-        m_serverHelper[serverIndex].SetAttribute("CalcTime", StringValue(meanTime.str()));
-        ApplicationContainer servers = m_p2pHelper.InstallApp(m_serverHelper[serverIndex], nLayer, i, j);
-        NS_LOG_DEBUG("address: "<<m_p2pHelper.GetIpv4Address(nLayer,i,j,1)<<" port:"<< m_sinkPort+serverIndex <<" size: "<<addrTable.size());
-        servers.Get(0)->GetObject<MyTcpServer>()->SetAddressTable(addrTable);
-        servers.Start(Seconds(0.1));
-        servers.Stop(Seconds(m_simTime+5));
-        NS_LOG_DEBUG(serverIndex<<":"<<meanTime.str());
+        uint32_t sibling = m_p2pHelper.GetNodeId(nLayer,i,k);
+        Ipv4Address addr = m_p2pHelper.GetIpv4Address(sibling,1);
+        server->AddPeer(sibling, InetSocketAddress(addr,port), InetSocketAddress(addr,loadPort), 2);
       }
-      else{
-        uint32_t nProcess = m_processCount[nLayer];
-        std::stringstream meanTime;
-        meanTime << "ns3::ExponentialRandomVariable[Mean=" << m_process[serverIndex][nLayer]*nProcess << "]";
-        NS_LOG_DEBUG(serverIndex<<":"<<meanTime.str());
-        m_serverHelper[serverIndex].SetAttribute("CalcTime", StringValue(meanTime.str()));
-        ApplicationContainer servers = m_p2pHelper.InstallApp(m_serverHelper[serverIndex], nLayer, i, j);
-        servers.Start(Seconds(0.1));
-        servers.Stop(Seconds(m_simTime+5));
+    }
+  }
+
+  if(!m_offload[serverIndex].toParent || nLayer==0){
+    return;
+  }
+
+  // an overflow instance on each parent takes jobs of its children only
+  MyTcpServerHelper overflowHelper = m_serverHelper[serverIndex];
+  overflowHelper.SetAttribute("OffloadThreshold", UintegerValue(0));
+  overflowHelper.SetAttribute("OffloadWait", TimeValue(Seconds(0)));
+  overflowHelper.SetAttribute("StealThreshold", UintegerValue(0));
+  overflowHelper.SetAttribute("AggregateCount", UintegerValue(1));
+  overflowHelper.SetAttribute("CacheSize", UintegerValue(0));
+  std::stringstream meanTime;
+  meanTime << "ns3::ExponentialRandomVariable[Mean=" << m_process[serverIndex][nLayer-1]*std::max<uint32_t>(1,m_processCount[nLayer-1]) << "]";
+  overflowHelper.SetAttribute("CalcTime", StringValue(meanTime.str()));
+  for(size_t i=0;i<m_p2pHelper.GetNGroups(nLayer);i++){
+    // a parent without children has no overflow instance
+    if(m_p2pHelper.GetNNodes(nLayer,i)==0){
+      continue;
+    }
+    uint32_t parent = m_p2pHelper.GetGroupParentId(nLayer,i);
+    // the parent and its children may run on different ranks
+    Ptr<MyTcpServer> overflow;
+    if(m_p2pHelper.IsLocal(parent)){
+      ApplicationContainer servers = overflowHelper.Install(NodeList::GetNode(parent));
+      overflow = DynamicCast<MyTcpServer>(servers.Get(0));
+      m_stream += overflow->AssignStreams(m_stream);
+      servers.Start(Seconds(0.1)-std::min(Seconds(0.1), Simulator::Now()));
+      servers.Stop(Seconds(m_simTime+5)-Simulator::Now());
+    }
+    for(size_t j=0;j<m_p2pHelper.GetNNodes(nLayer,i);j++){
+      uint32_t child = m_p2pHelper.GetNodeId(nLayer,i,j);
+      Ipv4Address parentAddr = m_p2pHelper.GetParentAddress(nLayer,i,j,nLayer-1);
+      Ipv4Address childAddr = m_p2pHelper.GetIpv4Address(child,1);
+      if(m_p2pHelper.IsLocal(child)){
+        instances[child]->AddPeer(parent, InetSocketAddress(parentAddr,port), InetSocketAddress(parentAddr,loadPort), 1);
+      }
+      if(overflow){
+        overflow->AddPeer(child, InetSocketAddress(childAddr,port), InetSocketAddress(childAddr,loadPort), 1);
       }
     }
   }
-  m_serverPlace[serverIndex] = nLayer;
+}
+
+std::string MyOrchestrator::GetRankSuffix(){
+  // every rank writes the files of its own nodes
+  if(m_p2pHelper.GetNSystems()==1){
+    return "";
+  }
+  std::stringstream suffix;
+  suffix << "-" << MpiInterface::GetSystemId();
+  return suffix.str();
+}
+
+uint16_t MyOrchestrator::GetLoadPort(uint32_t serverIndex){
+  return GetServicePort(serverIndex)+1;
+}
+
+uint16_t MyOrchestrator::GetStatePort(uint32_t serverIndex){
+  return GetServicePort(serverIndex)+2;
+}
+
+uint16_t MyOrchestrator::GetServicePort(uint32_t serverIndex){
+  // every migration moves a service to new ports: each generation of each
+  // service owns a disjoint block of service, load and state ports above the sink
+  uint32_t block = m_generation[serverIndex]*m_currentServerNum+serverIndex;
+  uint32_t port = m_sinkPort+1+block*PORTS_PER_SERVICE;
+  NS_ABORT_MSG_IF(port+PORTS_PER_SERVICE-1>65535, "MyOrchestrator >> no ports left for service "<<serverIndex);
+  return port;
 }
 
 double MyOrchestrator::GetAccessDelay(uint32_t pktSize, DataRate bw, double lambda, double mu){
@@ -242,25 +530,18 @@ double MyOrchestrator::GetProcessDelay(double lambda, double mu){
 double MyOrchestrator::GetErlangC(DataRate bbw, DataRate abw, double rho, double mu){
   uint32_t m = (bbw*Seconds(1))/(abw*Seconds(1));
   double a = (bbw*Seconds(1))*rho/(abw*Seconds(1));
-  double l = (std::pow(a,m)/Factorial(m))*(1/(1-rho));
-  double sum = 0;
-  for(uint32_t i=0; i<=m; i++){
-    sum += (static_cast<double>(std::pow(a,i))/static_cast<double>(Factorial(i)));
-  }
-  double erlang = l/(sum+l);
-  return erlang;
-}
-
-uint32_t MyOrchestrator::Factorial(uint32_t m){
-  uint32_t sum = 1;
-  for(uint32_t i=1; i<=m; i++){
-    sum *= i;
-  }
-  return sum;
+  return MyQueueing::ErlangC(a, m);
 }
 
 void MyOrchestrator::Algorithm(){
   //AssignServer(0,3);
+  if(m_searchPlacement){
+    SearchPlacement();
+  }
+  if(m_reportLatency){
+    m_predicted = PredictLatency(m_place);
+    Simulator::Schedule(Seconds(m_simTime+9), &MyOrchestrator::ReportLatency, this);
+  }
   for(auto i: m_place){
     AddProcessCount(i);
   }
@@ -273,62 +554,442 @@ void MyOrchestrator::Algorithm(){
   AssignClient();
 }
 
+void MyOrchestrator::EnablePlacementSearch(bool apply){
+  m_searchPlacement = true;
+  m_applyPlacement = apply;
+  m_reportLatency = true;
+}
+
+void MyOrchestrator::EnableLatencyReport(){
+  m_reportLatency = true;
+}
+
+double MyOrchestrator::GetClientRate(){
+  // a client with the attributes of AssignClient, which is not installed yet
+  Ptr<MyOnOffApplication> client = CreateObject<MyOnOffApplication>();
+  client->SetAttribute("OffTime", StringValue(m_clientOffTime));
+  client->SetAttribute("Outstanding", UintegerValue(m_clientOutstanding));
+  for(auto& attribute: m_clientAttributes){
+    client->SetAttribute(attribute.first, *attribute.second);
+  }
+  client->SetAttribute("Replay", BooleanValue(!m_clientTrace.empty()));
+  double rate = client->GetMeanRate();
+  NS_ABORT_MSG_IF(rate<=0, "MyOrchestrator >> the latency prediction needs open-loop clients with a known mean rate, "
+                  "not a closed loop, a trace or the off time "<<m_clientOffTime);
+  return rate;
+}
+
+uint32_t MyOrchestrator::GetNInstances(uint32_t nLayer){
+  return m_p2pHelper.GetNLayerNodes(nLayer);
+}
+
+double MyOrchestrator::GetLinkDelay(uint32_t nLayer, double lambda){
+  uint32_t pktBits = m_clientPktSize*8;
+  DataRate bw = m_p2pHelper.GetDataRate(nLayer);
+  DataRate abw = m_p2pHelper.GetDataRate(m_p2pHelper.GetNLayers()-2);
+  double mu = bw.GetBitRate()/static_cast<double>(pktBits);
+  if(lambda>=mu){
+    return INFINITY;
+  }
+  double t = m_p2pHelper.GetDelay(nLayer).GetSeconds();
+  if(nLayer==m_p2pHelper.GetNLayers()-2 || bw.GetBitRate()<2*abw.GetBitRate()){
+    return t+GetAccessDelay(m_clientPktSize, bw, lambda, mu);
+  }
+  // a bottleneck link is a group of access links which share one queue
+  double accessMu = abw.GetBitRate()/static_cast<double>(pktBits);
+  double rho = lambda/mu;
+  return t+1/mu+GetBottleDelay(m_clientPktSize, bw, abw, rho*accessMu, accessMu);
+}
+
+double MyOrchestrator::PredictLatency(std::vector<uint32_t> place){
+  uint32_t leaf = m_p2pHelper.GetNLayers()-1;
+  double lambda = GetClientRate()*GetNInstances(leaf);
+  std::vector<uint32_t> nProcess(m_p2pHelper.GetNLayers(), 0);
+  for(auto i: place){
+    nProcess[i]++;
+  }
+
+  // the number of times a request crosses the links below each layer
+  std::vector<uint32_t> up(leaf, 0);
+  std::vector<uint32_t> down(leaf, 0);
+  double latency = 0;
+  uint32_t from = leaf;
+  uint32_t serverIndex = 0;
+  for(size_t n=0; n<=place.size(); n++){
+    uint32_t to = (n<place.size()) ? place[serverIndex] : leaf;
+    for(uint32_t l=std::min(from,to); l<std::max(from,to); l++){
+      if(from>to){
+        up[l]++;
+      }
+      else{
+        down[l]++;
+      }
+    }
+    from = to;
+    if(n==place.size()){
+      break;
+    }
+    double lambdaInstance = lambda/GetNInstances(to);
+    double mu = 1000000.0/(m_process[serverIndex][to]*nProcess[to]);
+    if(lambdaInstance>=mu){
+      return INFINITY;
+    }
+    latency += GetProcessDelay(lambdaInstance, mu);
+    auto chaine = m_chaine.find(serverIndex);
+    if(chaine==m_chaine.end()){
+      NS_ABORT_MSG_IF(n+1<place.size(), "MyOrchestrator >> services are not chained");
+      serverIndex = place.size();
+    }
+    else{
+      serverIndex = chaine->second;
+    }
+  }
+  for(uint32_t l=0; l<leaf; l++){
+    for(uint32_t count: {up[l], down[l]}){
+      if(count>0){
+        latency += count*GetLinkDelay(l, count*lambda/GetNInstances(l+1));
+      }
+    }
+  }
+  return latency;
+}
+
+void MyOrchestrator::SearchPlacement(){
+  uint32_t nLayers = m_p2pHelper.GetNLayers();
+  uint32_t nServers = m_process.size();
+  struct Candidate
+  {
+    std::vector<uint32_t> place;
+    double latency;
+    uint32_t nInstances;
+    bool pareto;
+  };
+  std::vector<Candidate> candidates;
+  std::vector<uint32_t> place(nServers, 0);
+  while(true){
+    Candidate candidate;
+    candidate.place = place;
+    candidate.latency = PredictLatency(place);
+    candidate.nInstances = 0;
+    for(auto i: place){
+      candidate.nInstances += GetNInstances(i);
+    }
+    candidate.pareto = false;
+    candidates.push_back(candidate);
+    size_t k = 0;
+    while(k<nServers && ++place[k]==nLayers){
+      place[k++] = 0;
+    }
+    if(k==nServers){
+      break;
+    }
+  }
+
+  std::vector<Candidate*> order;
+  for(auto& i: candidates){
+    order.push_back(&i);
+  }
+  std::sort(order.begin(), order.end(), [](Candidate* a, Candidate* b){
+    return a->nInstances<b->nInstances || (a->nInstances==b->nInstances && a->latency<b->latency);
+  });
+  double best = INFINITY;
+  for(auto i: order){
+    if(i->latency<best){
+      i->pareto = true;
+      best = i->latency;
+    }
+  }
+  Candidate* fastest = *std::min_element(order.begin(), order.end(), [](Candidate* a, Candidate* b){
+    return a->latency<b->latency;
+  });
+
+  std::stringstream file;
+  file << m_path << "/myPlacement" << GetRankSuffix() << ".csv";
+  std::ofstream ofs(file.str());
+  ofs << "place latency instances pareto" << std::endl;
+  for(auto& i: candidates){
+    for(size_t j=0; j<i.place.size(); j++){
+      ofs << (j==0 ? "" : "-") << i.place[j];
+    }
+    ofs << " " << i.latency << " " << i.nInstances << " " << i.pareto << std::endl;
+  }
+  ofs.close();
+
+  if(m_applyPlacement && fastest->latency<INFINITY){
+    m_place = fastest->place;
+  }
+  NS_LOG_INFO("MyOrchestrator >> best predicted latency "<<fastest->latency<<"s, in use "<<PredictLatency(m_place)<<"s");
+}
+
+void MyOrchestrator::LatencyTx(Ptr<const Packet> packet){
+  m_sentTime[RequestId(packet)] = Simulator::Now();
+}
+
+void MyOrchestrator::LatencyRx(Ptr<const Packet> packet, const Address& from){
+  auto itr = m_sentTime.find(RequestId(packet));
+  if(itr==m_sentTime.end()){
+    return;
+  }
+  m_latencySum += (Simulator::Now()-itr->second).GetSeconds();
+  m_nLatency++;
+  m_sentTime.erase(itr);
+}
+
+void MyOrchestrator::ReportLatency(){
+  double simulated = m_nLatency>0 ? m_latencySum/m_nLatency : 0;
+  std::stringstream file;
+  file << m_path << "/myLatency" << GetRankSuffix() << ".csv";
+  std::ofstream ofs(file.str());
+  ofs << "place predicted simulated responses pending" << std::endl;
+  for(size_t j=0; j<m_place.size(); j++){
+    ofs << (j==0 ? "" : "-") << m_place[j];
+  }
+  ofs << " " << m_predicted << " " << simulated << " " << m_nLatency << " " << m_sentTime.size() << std::endl;
+  ofs.close();
+  NS_LOG_INFO("MyOrchestrator >> predicted latency "<<m_predicted<<"s, simulated "<<simulated<<"s ("<<m_nLatency<<" responses)");
+}
+
+void MyOrchestrator::EnableMetrics(){
+  m_metrics = Create<MyMetrics>();
+}
+
+Ptr<MyMetrics> MyOrchestrator::GetMetrics(){
+  return m_metrics;
+}
+
+void MyOrchestrator::SetTraceCoverage(bool allGroups, double sampleRate){
+  m_traceAll = allGroups;
+  m_sampleRate = sampleRate;
+}
+
+void MyOrchestrator::EnableAggregateClients(){
+  m_aggregateClients = true;
+}
+
+void MyOrchestrator::SetMetricsTracer(){
+  m_metrics->SetSampleRate(m_sampleRate);
+  uint32_t leaf = m_p2pHelper.GetNLayers()-1;
+  std::set<uint32_t> queued;
+  auto connectQueues = [&](uint32_t layer, uint32_t group, Ptr<Node> node){
+    if(!queued.insert(node->GetId()).second){
+      return;
+    }
+    for(uint32_t d=0; d<node->GetNDevices(); d++){
+      Ptr<Queue<Packet>> queue = GetDeviceQueue(node->GetDevice(d));
+      if(queue){
+        m_metrics->AddQueue(layer, group);
+        queue->TraceConnectWithoutContext("PacketsInQueue", MakeBoundCallback(&MetricsQueue, m_metrics, layer, group));
+      }
+    }
+  };
+  uint32_t nClientGroups = m_traceAll ? m_p2pHelper.GetNGroups(leaf) : 1;
+  for(uint32_t i=0;i<nClientGroups;i++){
+    for(size_t j=0;j<m_p2pHelper.GetNNodes(leaf,i);j++){
+      Ptr<Node> node = m_p2pHelper.GetNode(leaf,i,j);
+      if(!GetClient(node->GetId())){
+        continue;
+      }
+      m_clients[node->GetId()]->TraceConnectWithoutContext("Tx", MakeBoundCallback(&MetricsRequest, m_metrics, i));
+      m_receivers[node->GetId()]->TraceConnectWithoutContext("Rx", MakeBoundCallback(&MetricsResponse, m_metrics, i));
+      m_receivers[node->GetId()]->TraceConnectWithoutContext("Breakdown", MakeBoundCallback(&MetricsBreakdown, m_metrics));
+      connectQueues(leaf, i, node);
+    }
+  }
+  for(auto k: m_serverPlace){
+    uint32_t nGroups = m_traceAll ? m_p2pHelper.GetNGroups(k.second) : 1;
+    for(uint32_t i=0;i<nGroups;i++){
+      uint32_t nNodes = m_traceAll ? m_p2pHelper.GetNNodes(k.second,i) : 1;
+      for(uint32_t j=0;j<nNodes;j++){
+        Ptr<Node> node = m_p2pHelper.GetNode(k.second,i,j);
+        Ptr<MyTcpServer> server = GetServer(k.first, node->GetId());
+        if(!server){
+          continue;
+        }
+        server->TraceConnectWithoutContext("Rx", MakeBoundCallback(&MetricsStageRx, m_metrics, k.first));
+        server->TraceConnectWithoutContext("Tx", MakeBoundCallback(&MetricsStageTx, m_metrics, k.first, i));
+        connectQueues(k.second, i, node);
+      }
+    }
+  }
+  if(m_traceAll){
+    // the routers between the services and the clients
+    for(uint32_t layer=0;layer<leaf;layer++){
+      for(uint32_t i=0;i<m_p2pHelper.GetNGroups(layer);i++){
+        for(uint32_t j=0;j<m_p2pHelper.GetNNodes(layer,i);j++){
+          if(m_p2pHelper.IsLocal(m_p2pHelper.GetNodeId(layer,i,j))){
+            connectQueues(layer, i, m_p2pHelper.GetNode(layer,i,j));
+          }
+        }
+      }
+    }
+  }
+  Simulator::Schedule(Seconds(m_simTime+9), &MyOrchestrator::ReportMetrics, this);
+}
+
+void MyOrchestrator::ReportMetrics(){
+  std::stringstream file;
+  file << m_path << "/myMetrics" << GetRankSuffix() << ".txt";
+  std::ofstream ofs(file.str());
+  m_metrics->Report(ofs);
+  ofs.close();
+}
+
+void MyOrchestrator::EnableBinaryTrace(bool threaded){
+  m_binaryTrace = true;
+  m_binaryThreaded = threaded;
+}
+
+void MyOrchestrator::SetBinaryTracer(){
+  std::stringstream file;
+  file << m_path << "/myTrace" << GetRankSuffix() << ".bin";
+  m_traceWriter = Create<MyTraceWriter>(file.str(), m_binaryThreaded);
+  uint32_t leaf = m_p2pHelper.GetNLayers()-1;
+  std::set<uint32_t> queued;
+  auto connectQueues = [&](Ptr<Node> node){
+    if(!queued.insert(node->GetId()).second){
+      return;
+    }
+    ConnectQueues(node, MakeBoundCallback(&BinaryQueue, m_traceWriter, node->GetId()));
+  };
+  uint32_t nClientGroups = m_traceAll ? m_p2pHelper.GetNGroups(leaf) : 1;
+  for(uint32_t i=0;i<nClientGroups;i++){
+    for(size_t j=0;j<m_p2pHelper.GetNNodes(leaf,i);j++){
+      uint32_t id = m_p2pHelper.GetNode(leaf,i,j)->GetId();
+      if(!GetClient(id)){
+        continue;
+      }
+      m_clients[id]->TraceConnectWithoutContext("Tx", MakeBoundCallback(&BinaryClientTx, m_traceWriter, id));
+      m_receivers[id]->TraceConnectWithoutContext("Rx", MakeBoundCallback(&BinaryClientRx, m_traceWriter, id));
+      connectQueues(NodeList::GetNode(id));
+    }
+  }
+  for(auto k: m_serverPlace){
+    for(auto& instance: m_servers[k.first]){
+      Ptr<Node> node = NodeList::GetNode(instance.first);
+      if(!m_traceAll && node!=m_p2pHelper.GetNode(k.second,0,0)){
+        continue;
+      }
+      instance.second->TraceConnectWithoutContext("Rx", MakeBoundCallback(&BinaryServerRx, m_traceWriter, node->GetId()));
+      instance.second->TraceConnectWithoutContext("Tx", MakeBoundCallback(&BinaryServerTx, m_traceWriter, node->GetId()));
+      connectQueues(node);
+    }
+  }
+  if(m_traceAll){
+    // the routers between the services and the clients
+    for(uint32_t layer=0;layer<leaf;layer++){
+      for(uint32_t i=0;i<m_p2pHelper.GetNGroups(layer);i++){
+        for(uint32_t j=0;j<m_p2pHelper.GetNNodes(layer,i);j++){
+          if(m_p2pHelper.IsLocal(m_p2pHelper.GetNodeId(layer,i,j))){
+            connectQueues(m_p2pHelper.GetNode(layer,i,j));
+          }
+        }
+      }
+    }
+  }
+  // after the last event, since the records of a closed writer are dropped
+  Simulator::ScheduleDestroy(&MyTraceWriter::Close, m_traceWriter);
+}
+
 void MyOrchestrator::SetTracer(){
+  if(m_traceAll && !m_binaryTrace && !m_metrics){
+    // one CSV file per node is not an option for the whole system
+    EnableMetrics();
+  }
+  if(m_metrics){
+    SetMetricsTracer();
+    return;
+  }
+  if(m_binaryTrace){
+    SetBinaryTracer();
+    return;
+  }
   AsciiTraceHelper asciiTraceHelper;
   {
     int i = 0;
     for(size_t j=0;j<m_p2pHelper.GetNNodes(m_p2pHelper.GetNLayers()-1,i);j++){
       uint32_t id = m_p2pHelper.GetNode(m_p2pHelper.GetNLayers()-1,i,j)->GetId();
+      if(!GetClient(id)){
+        continue;
+      }
       std::stringstream txFile;
       txFile << m_path << "/myEndTx-" << id << ".csv";
-      std::stringstream txPath;
-      txPath << "/NodeList/" << id << "/ApplicationList/*/$ns3::MyOnOffApplication/Tx";
       Ptr<OutputStreamWrapper> txStream = asciiTraceHelper.CreateFileStream(txFile.str().c_str());
-      Config::ConnectWithoutContext(txPath.str().c_str(),MakeBoundCallback(&TxTracer, txStream));
+      m_clients[id]->TraceConnectWithoutContext("Tx", MakeBoundCallback(&TxTracer, txStream));
       std::stringstream rxFile;
       rxFile << m_path << "/myEndRx-" << id << ".csv";
-      std::stringstream rxPath;
-      rxPath << "/NodeList/" << id << "/ApplicationList/*/$ns3::MyReceiveServer/Rx";
       Ptr<OutputStreamWrapper> rxStream = asciiTraceHelper.CreateFileStream(rxFile.str().c_str());
-      Config::ConnectWithoutContext(rxPath.str().c_str(),MakeBoundCallback(&RxTracer, rxStream));
+      m_receivers[id]->TraceConnectWithoutContext("Rx", MakeBoundCallback(&RxTracer, rxStream));
       std::stringstream qFile;
       qFile << m_path << "/myQueueLen-" << id << ".csv";
-      std::stringstream qPath;
-      qPath << "/NodeList/" << id << "/DeviceList/*/$ns3::PointToPointNetDevice/TxQueue/PacketsInQueue";
       Ptr<OutputStreamWrapper> qStream = asciiTraceHelper.CreateFileStream(qFile.str().c_str());
-      Config::ConnectWithoutContext(qPath.str().c_str(),MakeBoundCallback(&QueueTracer, qStream));
+      ConnectQueues(NodeList::GetNode(id), MakeBoundCallback(&QueueTracer, qStream));
     }
   }
 
   {
     int i = 0;
     int j = 0;
-    std::vector<uint32_t> counter(m_p2pHelper.GetNLayers(),0);
+    std::set<uint32_t> queued;
     for(auto k: m_serverPlace){
-      uint32_t id = m_p2pHelper.GetNode(k.second,i,j)->GetId();
+      uint32_t id = m_p2pHelper.GetNodeId(k.second,i,j);
+      Ptr<MyTcpServer> server = GetServer(k.first, id);
+      if(!server){
+        continue;
+      }
       std::stringstream txFile;
       txFile << m_path << "/myServer"<<k.first<<"Tx-" << id << ".csv";
-      std::stringstream txPath;
-      txPath << "/NodeList/" << id << "/ApplicationList/"<<counter[k.second]<<"/$ns3::MyTcpServer/Tx";
       Ptr<OutputStreamWrapper> txStream = asciiTraceHelper.CreateFileStream(txFile.str().c_str());
-      Config::ConnectWithoutContext (txPath.str().c_str(), MakeBoundCallback(&TxTracer, txStream));
+      server->TraceConnectWithoutContext("Tx", MakeBoundCallback(&TxTracer, txStream));
       std::stringstream rxFile;
       rxFile << m_path << "/myServer"<<k.first<<"Rx-" << id << ".csv";
-      std::stringstream rxPath;
-      rxPath << "/NodeList/" << id << "/ApplicationList/"<<counter[k.second]<<"/$ns3::MyTcpServer/Rx";
       Ptr<OutputStreamWrapper> rxStream = asciiTraceHelper.CreateFileStream(rxFile.str().c_str());
-      Config::ConnectWithoutContext (rxPath.str().c_str(), MakeBoundCallback(&RxTracer, rxStream));
-      counter[k.second] += 1;
+      server->TraceConnectWithoutContext("Rx", MakeBoundCallback(&RxTracer, rxStream));
+      if(!queued.insert(id).second){
+        continue;
+      }
       std::stringstream qFile;
       qFile << m_path << "/myQueueLen-" << id << ".csv";
-      std::stringstream qPath;
-      qPath << "/NodeList/" << id << "/DeviceList/*/$ns3::PointToPointNetDevice/TxQueue/PacketsInQueue";
       Ptr<OutputStreamWrapper> qStream = asciiTraceHelper.CreateFileStream(qFile.str().c_str());
-      Config::ConnectWithoutContext(qPath.str().c_str(),MakeBoundCallback(&QueueTracer, qStream));
+      ConnectQueues(NodeList::GetNode(id), MakeBoundCallback(&QueueTracer, qStream));
     }
   }
 }
 
+ApplicationContainer MyOrchestrator::GetClientApps(){
+  return m_clientApps;
+}
+
+ApplicationContainer MyOrchestrator::GetReceiverApps(){
+  return m_receiverApps;
+}
+
+ApplicationContainer MyOrchestrator::GetServerApps(uint32_t serverIndex){
+  ApplicationContainer apps;
+  for(auto& i: m_servers[serverIndex]){
+    apps.Add(i.second);
+  }
+  return apps;
+}
+
+Ptr<MyOnOffApplication> MyOrchestrator::GetClient(uint32_t nodeId){
+  auto itr = m_clients.find(nodeId);
+  return itr==m_clients.end() ? nullptr : itr->second;
+}
+
+Ptr<MyReceiveServer> MyOrchestrator::GetReceiver(uint32_t nodeId){
+  auto itr = m_receivers.find(nodeId);
+  return itr==m_receivers.end() ? nullptr : itr->second;
+}
+
+Ptr<MyTcpServer> MyOrchestrator::GetServer(uint32_t serverIndex, uint32_t nodeId){
+  auto service = m_servers.find(serverIndex);
+  if(service==m_servers.end()){
+    return nullptr;
+  }
+  auto itr = service->second.find(nodeId);
+  return itr==service->second.end() ? nullptr : itr->second;
+}
+
 //void MyOrchestrator::SetPlace(uint32_t top, uint32_t mid, uint32_t end){
 void MyOrchestrator::SetPlace(std::vector<uint32_t> place){
   m_place = place;
@@ -338,6 +999,225 @@ void MyOrchestrator::SetPath(std::string path){
   m_path = path;
 }
 
+void MyOrchestrator::SetAggregation(uint32_t serverIndex, uint32_t count, Time window, double ratio){
+  m_serverHelper[serverIndex].SetAttribute("AggregateCount", UintegerValue(count));
+  m_serverHelper[serverIndex].SetAttribute("AggregateWindow", TimeValue(window));
+  m_serverHelper[serverIndex].SetAttribute("AggregateRatio", DoubleValue(ratio));
+}
+
+void MyOrchestrator::SetOutputRatio(uint32_t serverIndex, double ratio){
+  m_serverHelper[serverIndex].SetAttribute("OutputRatio", DoubleValue(ratio));
+}
+
+void MyOrchestrator::SetCache(uint32_t serverIndex, uint32_t size, MyResultCache::Policy policy, Time ttl, MyTcpServer::CacheKey key){
+  m_serverHelper[serverIndex].SetAttribute("CacheSize", UintegerValue(size));
+  m_serverHelper[serverIndex].SetAttribute("CachePolicy", EnumValue(policy));
+  m_serverHelper[serverIndex].SetAttribute("CacheTtl", TimeValue(ttl));
+  m_serverHelper[serverIndex].SetAttribute("CacheKey", EnumValue(key));
+}
+
+void MyOrchestrator::SetOffload(uint32_t serverIndex, uint32_t threshold, Time wait, bool toParent){
+  OffloadConfig& config = m_offload[serverIndex];
+  config.threshold = threshold;
+  config.wait = wait;
+  config.toParent = toParent;
+}
+
+void MyOrchestrator::SetStealing(uint32_t serverIndex, uint32_t threshold, Time interval, MyTcpServer::StealPolicy policy){
+  OffloadConfig& config = m_offload[serverIndex];
+  config.stealThreshold = threshold;
+  config.stealInterval = interval;
+  config.stealPolicy = policy;
+}
+
+void MyOrchestrator::SetClientClosedLoop(uint32_t outstanding, std::string thinkTime){
+  m_clientOutstanding = outstanding;
+  m_clientThinkTime = thinkTime;
+}
+
+void MyOrchestrator::SetClientTrace(std::string path){
+  m_clientTrace = path;
+}
+
+void MyOrchestrator::SetClientAttribute(std::string name, const AttributeValue& value){
+  m_clientAttributes.push_back(std::make_pair(name, value.Copy()));
+}
+
+void MyOrchestrator::SetClientKey(std::string key){
+  m_clientKey = key;
+}
+
+void MyOrchestrator::EnableMigration(uint32_t serverIndex, Time interval, uint32_t stateSize, double gain){
+  NS_ABORT_MSG_IF(m_p2pHelper.GetNSystems()>1, "MyOrchestrator >> migration needs the instances of every rank");
+  MigrationConfig& config = m_migration[serverIndex];
+  config.interval = interval;
+  config.stateSize = stateSize;
+  config.gain = gain;
+  // the first sample is taken after the clients have started
+  config.event = Simulator::Schedule(Seconds(1.0)+interval, &MyOrchestrator::Sample, this, serverIndex);
+}
+
+void MyOrchestrator::SetPlacementPolicy(Callback<uint32_t, uint32_t, uint32_t, double, uint32_t> policy){
+  m_placementPolicy = policy;
+}
+
+void MyOrchestrator::Sample(uint32_t serverIndex){
+  MigrationConfig& config = m_migration[serverIndex];
+  config.event = Simulator::Schedule(config.interval, &MyOrchestrator::Sample, this, serverIndex);
+  uint64_t nRequests = 0;
+  uint32_t nJobs = 0;
+  for(auto& i: m_servers[serverIndex]){
+    nRequests += i.second->GetNRequests();
+    nJobs += i.second->GetNJobs();
+  }
+  double lambda = (nRequests-config.nRequests)/config.interval.GetSeconds();
+  config.nRequests = nRequests;
+  uint32_t current = m_serverPlace[serverIndex];
+  NS_LOG_DEBUG("MyOrchestrator >> service "<<serverIndex<<" on layer "<<current<<" lambda "<<lambda<<" jobs "<<nJobs);
+  if(m_isMigrating || lambda==0){
+    return;
+  }
+  uint32_t nLayer;
+  if(m_placementPolicy.IsNull()){
+    nLayer = SelectLayer(serverIndex, current, lambda, nJobs);
+  }
+  else{
+    nLayer = m_placementPolicy(serverIndex, current, lambda, nJobs);
+  }
+  if(nLayer!=current && nLayer<m_p2pHelper.GetNLayers()){
+    Migrate(serverIndex, nLayer);
+  }
+}
+
+uint32_t MyOrchestrator::SelectLayer(uint32_t serverIndex, uint32_t current, double lambda, uint32_t nJobs){
+  // M/M/1 sojourn time of an instance, the arrivals are shared by the instances of the layer
+  size_t nLayers = m_p2pHelper.GetNLayers();
+  std::vector<double> lambdas(nLayers);
+  std::vector<double> mus(nLayers);
+  std::vector<uint32_t> servers(nLayers, 1);
+  for(size_t l=0; l<nLayers; l++){
+    uint32_t nProcess = m_processCount[l]+(l==current ? 0 : 1);
+    mus[l] = 1000000.0/(m_process[serverIndex][l]*nProcess);
+    lambdas[l] = lambda/GetNInstances(l);
+  }
+  std::vector<double> sojourn;
+  MyQueueing::MmcWait(lambdas, mus, servers, sojourn);
+  for(size_t l=0; l<nLayers; l++){
+    sojourn[l] += 1/mus[l];
+  }
+  uint32_t best = std::min_element(sojourn.begin(), sojourn.end())-sojourn.begin();
+  NS_LOG_DEBUG("MyOrchestrator >> layer "<<best<<" sojourn "<<sojourn[best]<<" (current "<<sojourn[current]<<")");
+  if(sojourn[best]<sojourn[current]*(1-m_migration[serverIndex].gain)){
+    return best;
+  }
+  return current;
+}
+
+void MyOrchestrator::Migrate(uint32_t serverIndex, uint32_t nLayer){
+  uint32_t oldLayer = m_serverPlace[serverIndex];
+  NS_LOG_INFO("MyOrchestrator >> migrate service "<<serverIndex<<" from layer "<<oldLayer<<" to "<<nLayer);
+  m_isMigrating = true;
+  m_migratingServer = serverIndex;
+  m_migratingTo = nLayer;
+  m_migrationStart = Simulator::Now();
+  m_stateRx = 0;
+  m_stateTotal = 0;
+  m_processCount[oldLayer]--;
+  AddProcessCount(nLayer);
+  m_generation[serverIndex]++;
+  m_newServers = InstallServer(serverIndex, nLayer, Seconds(0));
+
+  // the state of each new instance comes from the old instance above or below it
+  uint32_t stateSize = m_migration[serverIndex].stateSize;
+  uint16_t statePort = GetStatePort(serverIndex);
+  PacketSinkHelper sinkHelper(m_protocol, InetSocketAddress(Ipv4Address::GetAny(), statePort));
+  for(size_t i=0; i<m_p2pHelper.GetNGroups(nLayer) && stateSize>0; i++){
+    for(size_t j=0; j<m_p2pHelper.GetNNodes(nLayer,i); j++){
+      uint32_t from;
+      if(oldLayer<nLayer){
+        from = m_p2pHelper.GetParentId(nLayer,i,j,oldLayer);
+      }
+      else{
+        from = m_p2pHelper.GetChildrenRange(m_p2pHelper.GetNodeId(nLayer,i,j),oldLayer-nLayer).first;
+      }
+      ApplicationContainer sink = m_p2pHelper.InstallApp(sinkHelper, nLayer, i, j);
+      sink.Get(0)->TraceConnectWithoutContext("Rx", MakeCallback(&MyOrchestrator::StateReceived, this));
+      sink.Start(Seconds(0));
+      sink.Stop(Seconds(m_simTime+5)-Simulator::Now());
+      BulkSendHelper sendHelper(m_protocol, InetSocketAddress(m_p2pHelper.GetIpv4Address(nLayer,i,j,1), statePort));
+      sendHelper.SetAttribute("MaxBytes", UintegerValue(stateSize));
+      ApplicationContainer send = sendHelper.Install(NodeList::GetNode(from));
+      send.Start(Seconds(0));
+      send.Stop(Seconds(m_simTime+5)-Simulator::Now());
+      m_stateTotal += stateSize;
+    }
+  }
+  if(m_stateTotal==0){
+    SwitchOver();
+  }
+}
+
+void MyOrchestrator::StateReceived(Ptr<const Packet> packet, const Address& from){
+  m_stateRx += packet->GetSize();
+  if(m_isMigrating && m_stateTotal>0 && m_stateRx>=m_stateTotal){
+    SwitchOver();
+  }
+}
+
+void MyOrchestrator::SwitchOver(){
+  uint32_t serverIndex = m_migratingServer;
+  uint32_t nLayer = m_migratingTo;
+  uint32_t oldLayer = m_serverPlace[serverIndex];
+  std::map<uint32_t, Ptr<MyTcpServer>> oldServers = m_servers[serverIndex];
+  m_serverPlace[serverIndex] = nLayer;
+  m_servers[serverIndex] = m_newServers;
+  m_newServers.clear();
+
+  // redirect the previous services of the chain, or the clients
+  for(auto chaine: m_chaine){
+    if(chaine.second!=serverIndex){
+      continue;
+    }
+    uint32_t prevLayer = m_serverPlace[chaine.first];
+    for(size_t i=0; i<m_p2pHelper.GetNGroups(prevLayer); i++){
+      for(size_t j=0; j<m_p2pHelper.GetNNodes(prevLayer,i); j++){
+        Ptr<MyTcpServer> prev = m_servers[chaine.first][m_p2pHelper.GetNodeId(prevLayer,i,j)];
+        prev->UpdateAddressTable(CreateAddressTable(chaine.first, prevLayer, i, j));
+      }
+    }
+  }
+  if(serverIndex==0){
+    m_firstServer = nLayer;
+    uint32_t leaf = m_p2pHelper.GetNLayers()-1;
+    for(size_t i=0; i<m_p2pHelper.GetNGroups(leaf); i++){
+      for(size_t j=0; j<m_p2pHelper.GetNNodes(leaf,i); j++){
+        Ptr<MyOnOffApplication> client = GetClient(m_p2pHelper.GetNodeId(leaf,i,j));
+        if(!client){
+          continue;
+        }
+        client->SetRemote(InetSocketAddress(m_p2pHelper.GetParentAddress(leaf,i,j,m_firstServer), GetServicePort(0)));
+      }
+    }
+  }
+  for(auto& i: oldServers){
+    i.second->Drain();
+  }
+  if(m_offload.find(serverIndex)!=m_offload.end()){
+    ConnectPeers(serverIndex, nLayer, m_servers[serverIndex]);
+  }
+  m_migration[serverIndex].nRequests = 0;
+  m_isMigrating = false;
+
+  if(!m_migrationStream){
+    AsciiTraceHelper asciiTraceHelper;
+    std::stringstream file;
+    file << m_path << "/myMigration.csv";
+    m_migrationStream = asciiTraceHelper.CreateFileStream(file.str().c_str());
+  }
+  *m_migrationStream->GetStream() << serverIndex << " " << oldLayer << " " << nLayer << " " << m_migrationStart.GetNanoSeconds() << " " << Simulator::Now().GetNanoSeconds() << " " << m_stateRx << std::endl;
+  NS_LOG_INFO("MyOrchestrator >> service "<<serverIndex<<" moved to layer "<<nLayer<<" in "<<(Simulator::Now()-m_migrationStart).GetMilliSeconds()<<"ms");
+}
+
 void MyOrchestrator::AddProcessCount(uint32_t place){
   uint32_t tmp = m_processCount[place];
   m_processCount[place] = tmp+1;
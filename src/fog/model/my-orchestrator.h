@@ -30,6 +30,11 @@
 #include "ns3/applications-module.h"
 #include "ns3/my-tree.h"
 #include "ns3/my-tcp-server-helper.h"
+#include "ns3/my-onoff-application.h"
+#include "ns3/my-receive-server.h"
+#include "ns3/my-metrics.h"
+#include "ns3/my-trace-writer.h"
+#include "ns3/my-trace-replayer.h"
 
 namespace ns3 {
 
@@ -54,6 +59,12 @@ private:
   std::string m_clientOffTime;
   uint32_t m_clientPktSize;
   std::string m_clientDataRate;
+  std::string m_clientKey;
+  uint32_t m_clientOutstanding;
+  std::string m_clientThinkTime;
+  std::string m_clientTrace;
+  Ptr<MyTraceReplayer> m_replayer;
+  std::vector<std::pair<std::string, Ptr<AttributeValue>>> m_clientAttributes;
   uint32_t m_firstServer;
 
   std::vector<uint32_t> m_place;
@@ -62,6 +73,64 @@ private:
 
   std::string m_path;
 
+  struct OffloadConfig
+  {
+    uint32_t threshold = 0;
+    Time wait;
+    bool toParent = false;
+    uint32_t stealThreshold = 0;
+    Time stealInterval = MilliSeconds(10);
+    MyTcpServer::StealPolicy stealPolicy = MyTcpServer::STEAL_RANDOM;
+  };
+  std::map<uint32_t, OffloadConfig> m_offload;
+
+  std::map<uint32_t, Ipv4Address> m_allowAddress;
+  std::map<uint32_t, uint32_t> m_generation; //!< the number of migrations of each service
+  std::map<uint32_t, std::map<uint32_t, Ptr<MyTcpServer>>> m_servers; //!< running instances by node id
+  std::map<uint32_t, Ptr<MyOnOffApplication>> m_clients;
+  std::map<uint32_t, Ptr<MyReceiveServer>> m_receivers; //!< the actuator of each client
+  ApplicationContainer m_clientApps;
+  ApplicationContainer m_receiverApps;
+
+  struct MigrationConfig
+  {
+    Time interval;
+    uint32_t stateSize = 0;
+    double gain = 0;
+    uint64_t nRequests = 0;   //!< received requests at the last sample
+    EventId event;
+  };
+  std::map<uint32_t, MigrationConfig> m_migration;
+  Callback<uint32_t, uint32_t, uint32_t, double, uint32_t> m_placementPolicy;
+
+  // the migration in progress, only one at a time
+  bool m_isMigrating;
+  uint32_t m_migratingServer;
+  uint32_t m_migratingTo;
+  Time m_migrationStart;
+  uint64_t m_stateRx;
+  uint64_t m_stateTotal;
+  std::map<uint32_t, Ptr<MyTcpServer>> m_newServers;
+  Ptr<OutputStreamWrapper> m_migrationStream;
+
+  // analytic placement search
+  bool m_searchPlacement;
+  bool m_applyPlacement;
+  bool m_reportLatency;
+  double m_predicted;                        //!< predicted latency of the placement in use [s]
+  std::map<uint64_t, Time> m_sentTime;    //!< send time of requests in flight
+  double m_latencySum;
+  uint64_t m_nLatency;
+
+  Ptr<MyMetrics> m_metrics;
+  bool m_binaryTrace;
+  bool m_binaryThreaded;
+  Ptr<MyTraceWriter> m_traceWriter;
+  bool m_traceAll;
+  double m_sampleRate;
+  bool m_aggregateClients;
+  int64_t m_stream; //!< next random stream assigned to an application
+
 public:
   void Assign();
   uint32_t AddServerHelper(std::vector<double> meanCalctime, Ipv4Address allowAddress);
@@ -73,17 +142,142 @@ public:
   void SetClientPktSize(uint32_t pktSize);
   void SetPlace(std::vector<uint32_t> place);
   void SetPath(std::string path);
+  void SetAggregation(uint32_t serverIndex, uint32_t count, Time window, double ratio);
+  /**
+   * \param ratio size of the output of the service relative to its requests
+   */
+  void SetOutputRatio(uint32_t serverIndex, double ratio);
+  void SetCache(uint32_t serverIndex, uint32_t size, MyResultCache::Policy policy, Time ttl, MyTcpServer::CacheKey key);
+  void SetClientKey(std::string key);
+  /**
+   * Run the clients in closed loop: each keeps outstanding requests in flight
+   * and sends the next one a think time after a response (see MyOnOffApplication).
+   * \param thinkTime attribute string of a random variable [us]
+   */
+  void SetClientClosedLoop(uint32_t outstanding, std::string thinkTime);
+  /**
+   * Send the requests of a trace instead of the off times (see MyTraceReplayer).
+   * Client c of the trace is the leaf c modulo the number of leaves, in the
+   * order of the node ids.
+   */
+  void SetClientTrace(std::string path);
+  /**
+   * Set an attribute of every client, e.g. the arrival process and the
+   * request sizes. The BurstGroup of a client is the index of its group.
+   */
+  void SetClientAttribute(std::string name, const AttributeValue& value);
+  void SetOffload(uint32_t serverIndex, uint32_t threshold, Time wait, bool toParent);
+  void SetStealing(uint32_t serverIndex, uint32_t threshold, Time interval, MyTcpServer::StealPolicy policy);
+
+  /**
+   * Re-place a service while the simulation runs.
+   * The controller samples the arrival rate and the queues of the service
+   * every interval and moves it when the placement policy selects another layer.
+   * \param serverIndex the service to move
+   * \param interval sampling interval
+   * \param stateSize bytes of state sent from the old instances to the new ones
+   * \param gain relative improvement of the expected sojourn time needed to move
+   */
+  void EnableMigration(uint32_t serverIndex, Time interval, uint32_t stateSize, double gain);
+  /**
+   * Replace the default placement policy.
+   * The policy is called with the service, its current layer, the arrival rate [1/s]
+   * and the number of jobs in its instances, and returns the layer to place it on.
+   */
+  void SetPlacementPolicy(Callback<uint32_t, uint32_t, uint32_t, double, uint32_t> policy);
+
+  /**
+   * Predict the latency of every placement before the simulation starts.
+   * The candidates and their Pareto set (latency vs the number of instances)
+   * are written to myPlacement.csv, and the predicted latency of the placement
+   * in use is compared with the simulated one in myLatency.csv.
+   * \param apply install the best placement instead of the one set by SetPlace
+   */
+  void EnablePlacementSearch(bool apply);
+  /**
+   * Mean end-to-end latency [s] of a placement from M/M/1 and Erlang-C models
+   * of the links and the services, or INFINITY if any of them is overloaded.
+   * \param place layer of each service
+   */
+  double PredictLatency(std::vector<uint32_t> place);
+  /**
+   * Write the predicted and the simulated mean latency to myLatency.csv.
+   */
+  void EnableLatencyReport();
+  /**
+   * Collect latency histograms, throughput and queue summaries in memory
+   * instead of writing per-packet CSV files, and write them to myMetrics.txt.
+   */
+  void EnableMetrics();
+  Ptr<MyMetrics> GetMetrics();
+  /**
+   * Write the traces of the sampled nodes as fixed-size binary records
+   * to myTrace.bin instead of CSV files (see scratch/myTraceToCsv.cc).
+   * \param threaded write the buffers on a background thread
+   */
+  void EnableBinaryTrace(bool threaded);
+  /**
+   * Trace every client, service instance and net device instead of group 0 only.
+   * The metrics are aggregated per layer and group; without a binary trace
+   * the metrics collector is used, since CSV files per node do not scale.
+   * \param allGroups trace all groups
+   * \param sampleRate fraction of the requests whose latencies are kept
+   */
+  void SetTraceCoverage(bool allGroups, double sampleRate);
+  /**
+   * Replace the clients of each leaf group with one source on the first leaf
+   * that sends the superposed requests of the group, tagged with the address
+   * and actuator of their logical client (see MyOnOffApplication::AddLogicalClient).
+   * The other leaves stay idle, and the uplink of the first leaf carries the
+   * load of the group, so it may need a larger bandwidth (SetLinkAttributes).
+   */
+  void EnableAggregateClients();
+
+  /**
+   * Applications installed by Assign, to connect traces without Config paths.
+   * The instances of a service change when it migrates.
+   */
+  ApplicationContainer GetClientApps();
+  ApplicationContainer GetReceiverApps();
+  ApplicationContainer GetServerApps(uint32_t serverIndex);
+  /**
+   * \return the application on the node, or 0 if there is none
+   */
+  Ptr<MyOnOffApplication> GetClient(uint32_t nodeId);
+  Ptr<MyReceiveServer> GetReceiver(uint32_t nodeId);
+  Ptr<MyTcpServer> GetServer(uint32_t serverIndex, uint32_t nodeId);
 
 private:
   void AssignClient();
   void AssignServer(uint32_t serverIndex, uint32_t nLayer);
+  std::map<uint32_t, Ptr<MyTcpServer>> InstallServer(uint32_t serverIndex, uint32_t nLayer, Time start);
+  std::map<Address, Address> CreateAddressTable(uint32_t serverIndex, uint32_t nLayer, uint32_t i, uint32_t j);
+  uint16_t GetServicePort(uint32_t serverIndex);
+  void Sample(uint32_t serverIndex);
+  uint32_t SelectLayer(uint32_t serverIndex, uint32_t current, double lambda, uint32_t nJobs);
+  void Migrate(uint32_t serverIndex, uint32_t nLayer);
+  void StateReceived(Ptr<const Packet> packet, const Address& from);
+  void SwitchOver();
+  void SearchPlacement();
+  double GetClientRate();
+  double GetLinkDelay(uint32_t nLayer, double lambda);
+  uint32_t GetNInstances(uint32_t nLayer);
+  void LatencyTx(Ptr<const Packet> packet);
+  void LatencyRx(Ptr<const Packet> packet, const Address& from);
+  void ReportLatency();
+  void ConnectPeers(uint32_t serverIndex, uint32_t nLayer, std::map<uint32_t, Ptr<MyTcpServer>> instances);
+  uint16_t GetLoadPort(uint32_t serverIndex);
+  uint16_t GetStatePort(uint32_t serverIndex); //!< receives the state of a migrated service
+  std::string GetRankSuffix();
   double GetAccessDelay(uint32_t pktSize, DataRate bw, double lambda, double mu);
   double GetBottleDelay(uint32_t pktSize, DataRate bbw, DataRate abw, double lambda, double mu);
   double GetProcessDelay(double lambda, double mu);
   double GetErlangC(DataRate bbw, DataRate abw, double rho, double mu);
-  uint32_t Factorial(uint32_t m);
   void Algorithm();
   void SetTracer();
+  void SetMetricsTracer();
+  void SetBinaryTracer();
+  void ReportMetrics();
   void AddProcessCount(uint32_t place);
 
 };
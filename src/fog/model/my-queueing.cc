@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement queueing formulas used to estimate delays of the fog services.
+
+#include <algorithm>
+#include <cmath>
+
+#include "my-queueing.h"
+
+namespace ns3 {
+
+double MyQueueing::ErlangB(double a, uint32_t c){
+  double b = 1.0;
+  for(uint32_t k=1; k<=c; k++){
+    b = a*b/(k+a*b);
+  }
+  return b;
+}
+
+double MyQueueing::ErlangC(double a, uint32_t c){
+  if(a>=c){
+    return 1.0;
+  }
+  double b = ErlangB(a, c);
+  return c*b/(c-a*(1.0-b));
+}
+
+double MyQueueing::MmcWait(double lambda, double mu, uint32_t c){
+  if(lambda>=c*mu){
+    return INFINITY;
+  }
+  return ErlangC(lambda/mu, c)/(c*mu-lambda);
+}
+
+void MyQueueing::ErlangC(const std::vector<double>& a, const std::vector<uint32_t>& c,
+                         std::vector<double>& erlang){
+  size_t n = a.size();
+  erlang.resize(n);
+  if(n==0){
+    return;
+  }
+  uint32_t maxC = *std::max_element(c.begin(), c.end());
+  std::vector<double> b(n, 1.0);
+  const double* pa = a.data();
+  const uint32_t* pc = c.data();
+  double* pb = b.data();
+  for(uint32_t k=1; k<=maxC; k++){
+    // queues with fewer servers keep their value
+    for(size_t i=0; i<n; i++){
+      double next = pa[i]*pb[i]/(k+pa[i]*pb[i]);
+      pb[i] = (k<=pc[i]) ? next : pb[i];
+    }
+  }
+  for(size_t i=0; i<n; i++){
+    erlang[i] = (pa[i]>=pc[i]) ? 1.0 : pc[i]*pb[i]/(pc[i]-pa[i]*(1.0-pb[i]));
+  }
+}
+
+void MyQueueing::MmcWait(const std::vector<double>& lambda, const std::vector<double>& mu,
+                         const std::vector<uint32_t>& c, std::vector<double>& wait){
+  size_t n = lambda.size();
+  std::vector<double> a(n);
+  for(size_t i=0; i<n; i++){
+    a[i] = lambda[i]/mu[i];
+  }
+  ErlangC(a, c, wait);
+  for(size_t i=0; i<n; i++){
+    double capacity = c[i]*mu[i];
+    wait[i] = (lambda[i]>=capacity) ? INFINITY : wait[i]/(capacity-lambda[i]);
+  }
+}
+
+} // namespace ns3
@@ -0,0 +1,68 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define queueing formulas used to estimate delays of the fog services.
+
+#ifndef MY_QUEUEING_H
+#define MY_QUEUEING_H
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Erlang-B/C and M/M/c formulas.
+ * Erlang-B is computed by the recurrence B(k) = a*B(k-1)/(k+a*B(k-1)),
+ * which stays in [0,1], so it neither overflows nor loses precision for
+ * thousands of servers, unlike a^c/c!.
+ */
+class MyQueueing
+{
+public:
+  /**
+   * \param a offered load (lambda/mu)
+   * \param c the number of servers
+   * \return blocking probability of M/M/c/c
+   */
+  static double ErlangB(double a, uint32_t c);
+  /**
+   * \return waiting probability of M/M/c, 1 if a >= c
+   */
+  static double ErlangC(double a, uint32_t c);
+  /**
+   * \return mean waiting time in the queue of M/M/c, INFINITY if unstable
+   */
+  static double MmcWait(double lambda, double mu, uint32_t c);
+
+  /**
+   * Evaluate many queues at once.
+   * The recurrence runs in lockstep over all queues, so the inner loop
+   * has no branch and is vectorized by the compiler.
+   * \param lambda arrival rate of each queue
+   * \param mu service rate of a server of each queue
+   * \param c the number of servers of each queue
+   * \param wait mean waiting time of each queue (resized)
+   */
+  static void MmcWait(const std::vector<double>& lambda, const std::vector<double>& mu,
+                      const std::vector<uint32_t>& c, std::vector<double>& wait);
+  static void ErlangC(const std::vector<double>& a, const std::vector<uint32_t>& c,
+                      std::vector<double>& erlang);
+};
+
+} // namespace ns3
+
+#endif /* MY_QUEUEING_H */
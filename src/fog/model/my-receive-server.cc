@@ -35,6 +35,7 @@
 #include "ns3/string.h"
 #include "ns3/pointer.h"
 
+#include "my-message.h"
 #include "my-receive-server.h"
 
 #include "sstream"
@@ -58,10 +59,6 @@ MyReceiveServer::GetTypeId (void)
                    AddressValue (),
                    MakeAddressAccessor (&MyReceiveServer::m_local),
                    MakeAddressChecker ())
-    .AddAttribute("PacketSize", "The size of packets sent in on state",
-                   UintegerValue(512),
-                   MakeUintegerAccessor(&MyReceiveServer::m_pktSize),
-                   MakeUintegerChecker<uint32_t>(1))
     .AddAttribute ("Protocol",
                    "The type id of the protocol to use for the rx socket.",
                    TypeIdValue (TcpSocketFactory::GetTypeId ()),
@@ -74,6 +71,9 @@ MyReceiveServer::GetTypeId (void)
     .AddTraceSource("Tx", "A new packet is created and is sent",
                      MakeTraceSourceAccessor(&MyReceiveServer::m_txTrace),
                      "ns3::Packet::TracedCallback")
+    .AddTraceSource("Breakdown", "Creation time and per-service timestamps of a response",
+                     MakeTraceSourceAccessor(&MyReceiveServer::m_breakdownTrace),
+                     "ns3::MyReceiveServer::BreakdownTracedCallback")
   ;
   return tid;
 }
@@ -189,11 +189,16 @@ void MyReceiveServer::HandleRead (Ptr<Socket> socket)
         buff[from]->AddAtEnd(packet);
       }
       NS_LOG_DEBUG("from " << InetSocketAddress::ConvertFrom(from).GetIpv4() << " size " << buff[from]->GetSize());
-      if(buff[from]->GetSize()>=m_pktSize){
-        Ptr<Packet> receivedPacket = buff[from]->CreateFragment(0,m_pktSize);
-        buff[from]->RemoveAtStart(m_pktSize);
+      Ptr<Packet> receivedPacket;
+      while(MyMessage::Pop(buff[from], receivedPacket)){
         m_rxTrace(receivedPacket, from);
         NS_LOG_DEBUG("MyReceiveServer("<<m_nodeAddress<<") >> receive a packet from "<<InetSocketAddress::ConvertFrom(from).GetIpv4());
+        auto json = MyMessage::Parse(receivedPacket);
+        if(json["Id"].is_string()){
+          m_breakdownTrace(MyMessage::GetRequestId(json),
+                           NanoSeconds(static_cast<int64_t>(json["Created"].number_value())),
+                           MyHop::Parse(json));
+        }
       }
     }
 }
@@ -226,14 +231,6 @@ bool MyReceiveServer::HandleRequest (Ptr<Socket> s, const Address& address)
   return true;
 }
 
-std::string MyReceiveServer::PacketDeserialize(Ptr<Packet> p){
-  uint8_t buf[m_pktSize];
-  p->CopyData(buf, m_pktSize);
-  std::stringstream text;
-  text << buf;
-  return text.str();
-}
-
 Address MyReceiveServer::ParseData(std::string data){
   std::string err;
   auto json = json11::Json::parse(data, err);
@@ -31,6 +31,7 @@
 #include "ns3/address.h"
 #include "ns3/drop-tail-queue.h"
 #include "ns3/my-queue-item.h"
+#include "ns3/my-hop-tag.h"
 
 namespace ns3 {
 
@@ -97,6 +98,14 @@ public:
    * \return list of pointers to accepted sockets
    */
   std::list<Ptr<Socket> > GetAcceptedSockets (void) const;
+
+  /**
+   * TracedCallback signature for the latency breakdown of a response.
+   * \param id request id given by the client
+   * \param created creation time of the request
+   * \param hops timestamps at each service, in the order of the chain
+   */
+  typedef void (* BreakdownTracedCallback) (uint64_t id, const Time& created, const std::vector<MyHop>& hops);
  
 protected:
   virtual void DoDispose (void);
@@ -140,18 +149,17 @@ private:
   // NIWA
   using MyQueue = DropTailQueue<MyAppQueueItem>;
 
-  uint32_t        m_pktSize;
   std::map<Address, Ptr<Packet>> buff;
   Ipv4Address m_nodeAddress; //own node address
 
   bool HandleRequest(Ptr<Socket> socket, const Address& from);
 
-  std::string PacketDeserialize(Ptr<Packet> packet);
   Address ParseData(std::string data);
 
   /// Traced Callback: received packets, source address.
   TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
   TracedCallback<Ptr<const Packet>> m_txTrace;
+  TracedCallback<uint64_t, const Time&, const std::vector<MyHop>&> m_breakdownTrace;
 };
 
 } // namespace ns3
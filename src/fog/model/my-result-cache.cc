@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement a keyed result cache for fog servers.
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include "my-result-cache.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MyResultCache");
+
+MyResultCache::MyResultCache ()
+  : m_capacity(0),
+    m_policy(LRU),
+    m_ttl(Seconds(0)),
+    m_tick(0),
+    m_nHits(0),
+    m_nMisses(0)
+{
+}
+
+MyResultCache::~MyResultCache ()
+{
+}
+
+void MyResultCache::SetCapacity(uint32_t capacity){
+  m_capacity = capacity;
+  while(m_entries.size()>m_capacity){
+    Evict();
+  }
+}
+
+void MyResultCache::SetPolicy(Policy policy){
+  NS_ASSERT_MSG(m_entries.empty(), "MyResultCache >> policy must be set before use");
+  m_policy = policy;
+}
+
+void MyResultCache::SetTtl(Time ttl){
+  m_ttl = ttl;
+}
+
+bool MyResultCache::Lookup(uint64_t key){
+  auto itr = m_entries.find(key);
+  if(itr==m_entries.end()){
+    m_nMisses++;
+    return false;
+  }
+  if(!m_ttl.IsZero() && itr->second.expire<=Simulator::Now()){
+    NS_LOG_DEBUG("MyResultCache >> key "<<key<<" expired");
+    Erase(key);
+    m_nMisses++;
+    return false;
+  }
+  Touch(key, itr->second);
+  m_nHits++;
+  return true;
+}
+
+void MyResultCache::Insert(uint64_t key){
+  if(m_capacity==0){
+    return;
+  }
+  auto itr = m_entries.find(key);
+  if(itr!=m_entries.end()){
+    itr->second.expire = Simulator::Now()+m_ttl;
+    Touch(key, itr->second);
+    return;
+  }
+  if(m_entries.size()>=m_capacity){
+    Evict();
+  }
+  Entry entry;
+  entry.expire = Simulator::Now()+m_ttl;
+  entry.freq = 1;
+  entry.lastUse = ++m_tick;
+  if(m_policy==LRU){
+    m_lru.push_front(key);
+    entry.lruPos = m_lru.begin();
+  }
+  else{
+    m_lfu.insert(LfuKey(entry.freq, entry.lastUse, key));
+  }
+  m_entries[key] = entry;
+}
+
+uint32_t MyResultCache::GetSize() const{
+  return m_entries.size();
+}
+
+uint64_t MyResultCache::GetNHits() const{
+  return m_nHits;
+}
+
+uint64_t MyResultCache::GetNMisses() const{
+  return m_nMisses;
+}
+
+void MyResultCache::Touch(uint64_t key, Entry& entry){
+  if(m_policy==LRU){
+    m_lru.splice(m_lru.begin(), m_lru, entry.lruPos);
+  }
+  else{
+    m_lfu.erase(LfuKey(entry.freq, entry.lastUse, key));
+    entry.freq++;
+    entry.lastUse = ++m_tick;
+    m_lfu.insert(LfuKey(entry.freq, entry.lastUse, key));
+  }
+}
+
+void MyResultCache::Erase(uint64_t key){
+  auto itr = m_entries.find(key);
+  if(m_policy==LRU){
+    m_lru.erase(itr->second.lruPos);
+  }
+  else{
+    m_lfu.erase(LfuKey(itr->second.freq, itr->second.lastUse, key));
+  }
+  m_entries.erase(itr);
+}
+
+void MyResultCache::Evict(){
+  if(m_entries.empty()){
+    return;
+  }
+  uint64_t victim;
+  if(m_policy==LRU){
+    victim = m_lru.back();
+  }
+  else{
+    victim = std::get<2>(*m_lfu.begin());
+  }
+  NS_LOG_DEBUG("MyResultCache >> evict key "<<victim);
+  Erase(victim);
+}
+
+} // namespace ns3
@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define a keyed result cache for fog servers.
+
+#ifndef MY_RESULT_CACHE_H
+#define MY_RESULT_CACHE_H
+
+#include <list>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * Keyed cache of service results with LRU or LFU eviction.
+ * Only the keys are kept, because the response is built from the request.
+ * Expired entries are removed when they are looked up.
+ */
+class MyResultCache
+{
+public:
+  enum Policy
+    {
+      LRU,
+      LFU
+    };
+
+  MyResultCache ();
+  ~MyResultCache ();
+
+  void SetCapacity(uint32_t capacity);
+  void SetPolicy(Policy policy);
+  void SetTtl(Time ttl);
+
+  /**
+   * \param key the key of the request
+   * \return true if the key is cached and not expired
+   */
+  bool Lookup(uint64_t key);
+  void Insert(uint64_t key);
+
+  uint32_t GetSize() const;
+  uint64_t GetNHits() const;
+  uint64_t GetNMisses() const;
+
+private:
+  using LfuKey = std::tuple<uint64_t, uint64_t, uint64_t>; //!< frequency, last use, key
+
+  struct Entry
+  {
+    Time expire;
+    uint64_t freq;
+    uint64_t lastUse;
+    std::list<uint64_t>::iterator lruPos;
+  };
+
+  void Touch(uint64_t key, Entry& entry);
+  void Erase(uint64_t key);
+  void Evict();
+
+  uint32_t m_capacity;
+  Policy m_policy;
+  Time m_ttl;
+  uint64_t m_tick;
+  uint64_t m_nHits;
+  uint64_t m_nMisses;
+
+  std::unordered_map<uint64_t, Entry> m_entries;
+  std::list<uint64_t> m_lru;    //!< most recently used first
+  std::set<LfuKey> m_lfu;       //!< least frequently used first
+};
+
+} // namespace ns3
+
+#endif /* MY_RESULT_CACHE_H */
@@ -34,8 +34,16 @@
 #include "ns3/uinteger.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/double.h"
+#include "ns3/abort.h"
+#include "ns3/enum.h"
+#include "my-hop-tag.h"
+#include "my-message.h"
 #include "my-tcp-server.h"
 
+#include <cmath>
+#include <algorithm>
+#include <functional>
 #include "sstream"
 #include "ns3/json.h"
 
@@ -45,6 +53,20 @@ NS_LOG_COMPONENT_DEFINE ("MyTcpServer");
 
 NS_OBJECT_ENSURE_REGISTERED (MyTcpServer);
 
+static Address
+ActuatorOf(const json11::Json& json)
+{
+  Ipv4Address aAddr(json["ActuatorId"]["Address"].string_value().c_str());
+  return InetSocketAddress(aAddr, json["ActuatorId"]["Port"].int_value());
+}
+
+static Address
+SourceOf(const json11::Json& json)
+{
+  Ipv4Address aAddr(json["NodeId"]["Address"].string_value().c_str());
+  return InetSocketAddress(aAddr);
+}
+
 TypeId 
 MyTcpServer::GetTypeId (void)
 {
@@ -57,10 +79,6 @@ MyTcpServer::GetTypeId (void)
                    AddressValue (),
                    MakeAddressAccessor (&MyTcpServer::m_local),
                    MakeAddressChecker ())
-    .AddAttribute("PacketSize", "The size of packets sent in on state",
-                   UintegerValue(512),
-                   MakeUintegerAccessor(&MyTcpServer::m_pktSize),
-                   MakeUintegerChecker<uint32_t>(1))
     .AddAttribute ("Protocol",
                    "The type id of the protocol to use for the rx socket.",
                    TypeIdValue (TcpSocketFactory::GetTypeId ()),
@@ -70,6 +88,83 @@ MyTcpServer::GetTypeId (void)
                    StringValue("ns3::ExponentialRandomVariable[Mean=1.0]"),
                    MakePointerAccessor(&MyTcpServer::m_calctime),
                    MakePointerChecker <RandomVariableStream>())
+    .AddAttribute("OutputRatio", "The size of the output of a request relative to its size, e.g. 0.1 for a feature extraction",
+                   DoubleValue(1.0),
+                   MakeDoubleAccessor(&MyTcpServer::m_outputRatio),
+                   MakeDoubleChecker<double>(0.0))
+    .AddAttribute("OutputSize", "A RandomVariableStream used to pick the size [bytes] of the output of a request instead of OutputRatio (optional)",
+                   PointerValue(),
+                   MakePointerAccessor(&MyTcpServer::m_outputSize),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute("AggregateCount", "The number of processed requests merged into one message to the next service (1 disables aggregation)",
+                   UintegerValue(1),
+                   MakeUintegerAccessor(&MyTcpServer::m_aggCount),
+                   MakeUintegerChecker<uint32_t>(1))
+    .AddAttribute("AggregateWindow", "The maximum time the first request of an aggregate waits for the others (0 waits for AggregateCount requests)",
+                   TimeValue(Seconds(0)),
+                   MakeTimeAccessor(&MyTcpServer::m_aggWindow),
+                   MakeTimeChecker())
+    .AddAttribute("AggregateRatio", "The size of an aggregate relative to the sum of the merged requests",
+                   DoubleValue(1.0),
+                   MakeDoubleAccessor(&MyTcpServer::m_aggRatio),
+                   MakeDoubleChecker<double>(0.0))
+    .AddAttribute("CacheSize", "The number of results kept in the cache (0 disables the cache)",
+                   UintegerValue(0),
+                   MakeUintegerAccessor(&MyTcpServer::m_cacheSize),
+                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute("CachePolicy", "The eviction policy of the cache",
+                   EnumValue(MyResultCache::LRU),
+                   MakeEnumAccessor(&MyTcpServer::m_cachePolicy),
+                   MakeEnumChecker(MyResultCache::LRU, "LRU",
+                                   MyResultCache::LFU, "LFU"))
+    .AddAttribute("CacheTtl", "The lifetime of a cached result (0 never expires)",
+                   TimeValue(Seconds(0)),
+                   MakeTimeAccessor(&MyTcpServer::m_cacheTtl),
+                   MakeTimeChecker())
+    .AddAttribute("CacheKey", "The field of a request used as the cache key",
+                   EnumValue(CACHE_PAYLOAD),
+                   MakeEnumAccessor(&MyTcpServer::m_cacheKey),
+                   MakeEnumChecker(CACHE_SOURCE, "Source",
+                                   CACHE_ACTUATOR, "Actuator",
+                                   CACHE_PAYLOAD, "Payload"))
+    .AddAttribute("OffloadThreshold", "The number of local jobs from which new jobs are offloaded to a less loaded peer (0 disables)",
+                   UintegerValue(0),
+                   MakeUintegerAccessor(&MyTcpServer::m_offloadThreshold),
+                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute("OffloadWait", "The predicted waiting time from which new jobs are offloaded to a less loaded peer (0 disables)",
+                   TimeValue(Seconds(0)),
+                   MakeTimeAccessor(&MyTcpServer::m_offloadWait),
+                   MakeTimeChecker())
+    .AddAttribute("LoadPort", "The UDP port on which load reports are exchanged with the peers (0 disables)",
+                   UintegerValue(0),
+                   MakeUintegerAccessor(&MyTcpServer::m_loadPort),
+                   MakeUintegerChecker<uint16_t>())
+    .AddAttribute("StealThreshold", "The reported load of a peer from which an idle server steals its waiting jobs (0 disables)",
+                   UintegerValue(0),
+                   MakeUintegerAccessor(&MyTcpServer::m_stealThreshold),
+                   MakeUintegerChecker<uint32_t>())
+    .AddAttribute("StealInterval", "The interval at which an idle server tries to steal a job",
+                   TimeValue(MilliSeconds(10)),
+                   MakeTimeAccessor(&MyTcpServer::m_stealInterval),
+                   MakeTimeChecker())
+    .AddAttribute("StealTimeout", "The time after which a peer that sent no job is asked again",
+                   TimeValue(MilliSeconds(100)),
+                   MakeTimeAccessor(&MyTcpServer::m_stealTimeout),
+                   MakeTimeChecker())
+    .AddAttribute("StealPolicy", "The selection of the peer a job is stolen from",
+                   EnumValue(STEAL_RANDOM),
+                   MakeEnumAccessor(&MyTcpServer::m_stealPolicy),
+                   MakeEnumChecker(STEAL_RANDOM, "Random",
+                                   STEAL_LEAST_RECENT, "LeastRecentlyStolen",
+                                   STEAL_NEAREST, "Nearest"))
+    .AddAttribute("LoadInterval", "The interval of load reports to the peers",
+                   TimeValue(MilliSeconds(100)),
+                   MakeTimeAccessor(&MyTcpServer::m_loadInterval),
+                   MakeTimeChecker())
+    .AddAttribute("LoadTimeout", "The age from which the last load report of a peer is ignored",
+                   TimeValue(MilliSeconds(300)),
+                   MakeTimeAccessor(&MyTcpServer::m_loadTimeout),
+                   MakeTimeChecker())
     .AddTraceSource ("Rx",
                      "A packet has been received",
                      MakeTraceSourceAccessor (&MyTcpServer::m_rxTrace),
@@ -80,17 +175,31 @@ MyTcpServer::GetTypeId (void)
     .AddTraceSource("ServiceTime", "Service Time",
                      MakeTraceSourceAccessor(&MyTcpServer::m_serviceTrace),
                      "ns3::MyTcpServer::ServiceTimeTracedCallback")
+    .AddTraceSource("CacheHit", "A request has been answered from the cache",
+                     MakeTraceSourceAccessor(&MyTcpServer::m_cacheHitTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource("CacheMiss", "A request was not found in the cache",
+                     MakeTraceSourceAccessor(&MyTcpServer::m_cacheMissTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource("Offload", "A job has been offloaded to a peer",
+                     MakeTraceSourceAccessor(&MyTcpServer::m_offloadTrace),
+                     "ns3::Packet::TracedCallback")
   ;
   return tid;
 }
 
 MyTcpServer::MyTcpServer ()
-  : m_isBusy(false)
+  : m_isBusy(false),
+    m_meanService(Seconds(0)),
+    m_nRequests(0),
+    m_isDraining(false),
+    m_isDrained(false)
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
   m_totalRx = 0;
   m_jobQueue.SetMaxPackets(10000000);
+  m_stealRng = CreateObject<UniformRandomVariable>();
 }
 
 MyTcpServer::~MyTcpServer()
@@ -122,7 +231,10 @@ void MyTcpServer::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
+  m_loadSocket = 0;
   m_socketList.clear ();
+  m_peerSockets.clear ();
+  m_nextServiceSocket.clear ();
 
   // chain up
   Application::DoDispose ();
@@ -159,7 +271,26 @@ void MyTcpServer::StartApplication ()    // Called at time specified by Start
       MakeCallback (&MyTcpServer::HandlePeerError, this));
   }
   m_nodeAddress = GetNode()->GetObject<Ipv4>()->GetAddress(1,0).GetLocal();
+  m_cache.SetPolicy(m_cachePolicy);
+  m_cache.SetCapacity(m_cacheSize);
+  m_cache.SetTtl(m_cacheTtl);
+
+  if(m_loadPort>0 && !m_loadSocket){
+    m_loadSocket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    if(m_loadSocket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_loadPort)) == -1){
+      NS_FATAL_ERROR("Failed to bind load socket");
+    }
+    m_loadSocket->SetRecvCallback(MakeCallback(&MyTcpServer::HandleLoad, this));
+    m_loadEvent = Simulator::Schedule(m_loadInterval, &MyTcpServer::ReportLoad, this);
+    if(m_stealThreshold>0){
+      m_stealEvent = Simulator::Schedule(m_stealInterval, &MyTcpServer::TrySteal, this);
+    }
+  }
+
+  ConnectNextServices();
+}
 
+void MyTcpServer::ConnectNextServices(){
   for(auto i: m_addrTable){
     NS_LOG_DEBUG("MyTcpServer(" << m_nodeAddress << ") >> start to create socket (end node: " << i.first <<" )");
     if(!static_cast<Address>(i.second).IsInvalid()){
@@ -190,6 +321,15 @@ void MyTcpServer::ConnectionFailed(Ptr<Socket> socket)
 void MyTcpServer::StopApplication ()     // Called at time specified by Stop
 {
   Simulator::Cancel(m_sendEvent);
+  for(auto i: m_aggEvent){
+    Simulator::Cancel(i.second);
+  }
+  Simulator::Cancel(m_loadEvent);
+  Simulator::Cancel(m_stealEvent);
+  if(m_loadSocket){
+    m_loadSocket->Close();
+    m_loadSocket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket> >());
+  }
   NS_LOG_FUNCTION (this);
   while(!m_socketList.empty ()) //these are accepted sockets, close them
   {
@@ -224,23 +364,42 @@ void MyTcpServer::HandleRead (Ptr<Socket> socket)
       buff[from]->AddAtEnd(packet);
     }
     NS_LOG_DEBUG("from " << InetSocketAddress::ConvertFrom(from).GetIpv4() << " size " << buff[from]->GetSize());
-    if(buff[from]->GetSize()>=m_pktSize){
-      Ptr<Packet> receivedPacket = buff[from]->CreateFragment(0,m_pktSize);
-      buff[from]->RemoveAtStart(m_pktSize);
+    Ptr<Packet> receivedPacket;
+    while(MyMessage::Pop(buff[from], receivedPacket)){
       m_rxTrace(receivedPacket, from);
+      m_nRequests++;
+      receivedPacket->RemoveAllPacketTags();
+      receivedPacket->AddPacketTag(MyHopTag(Simulator::Now()));
       NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> receive a packet from "<<InetSocketAddress::ConvertFrom(from).GetIpv4());
-      if(m_jobQueue.IsEmpty() && !m_isBusy){
-        m_isBusy = true;
-        Time calcInterval = MicroSeconds(m_calctime->GetValue());
-        m_serviceTrace(calcInterval);
-        NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> start...");
-        if(m_nextServiceSocket.empty()){
-          m_sendEvent = Simulator::Schedule (calcInterval, &MyTcpServer::Response, this, receivedPacket);
+      if(m_stealThreshold>0){
+        // a job from a peer answers the steal request sent to it
+        auto json = MyMessage::Parse(receivedPacket);
+        if(json["Offload"].is_object()){
+          auto peerItr = m_peers.find(json["Offload"]["From"].int_value());
+          if(peerItr!=m_peers.end()){
+            peerItr->second.stealPending = false;
+          }
         }
-        else{
-          m_sendEvent = Simulator::Schedule (calcInterval, &MyTcpServer::SendNext, this, receivedPacket);
+      }
+      if(m_cacheSize>0){
+        auto json = MyMessage::Parse(receivedPacket);
+        if(!json["Members"].is_array()){
+          if(m_cache.Lookup(GetCacheKey(json))){
+            NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> cache hit");
+            m_cacheHitTrace(receivedPacket);
+            MyHop hop{GetNode()->GetId(), Simulator::Now(), Simulator::Now(), Simulator::Now()};
+            SendResponse(ActuatorOf(json), MyMessage::CreateFrame(hop.AppendTo(json).dump(), GetOutputSize(receivedPacket->GetSize())));
+            continue;
+          }
+          m_cacheMissTrace(receivedPacket);
         }
       }
+      if(Offload(receivedPacket)){
+        continue;
+      }
+      if(m_jobQueue.IsEmpty() && !m_isBusy){
+        StartJob(receivedPacket);
+      }
       else{
         Ptr<MyAppQueueItem> newJob = Create<MyAppQueueItem>(receivedPacket, socket);
         NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> enqueue... (size: "<<m_jobQueue.GetCurrentSize()<<"/"<<m_jobQueue.GetMaxPackets()<<")");
@@ -250,69 +409,167 @@ void MyTcpServer::HandleRead (Ptr<Socket> socket)
   }
 }
 
-void MyTcpServer::Response(Ptr<Packet> packet){
+void MyTcpServer::StartJob(Ptr<Packet> packet){
   NS_LOG_FUNCTION(this);
-  //TODO
-  //you can add the logic to create response packet
-  Ptr<Packet> rePacket = packet;
-
-  Address peer = ParseActuator(PacketDeserialize(packet));
-
-  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> get actuator address "<<InetSocketAddress::ConvertFrom(peer).GetIpv4()<<" port "<<InetSocketAddress::ConvertFrom(peer).GetPort());
-
-  Ptr<Socket> distSocket;
-  auto socketItr = m_peerSockets.find(peer);
-  if(socketItr==m_peerSockets.end()){
-    distSocket = CreateSocket(peer);
-    m_peerSockets[peer] = distSocket;
+  m_isBusy = true;
+  Time calcInterval = MicroSeconds(m_calctime->GetValue());
+  m_serviceTrace(calcInterval);
+  if(m_meanService.IsZero()){
+    m_meanService = calcInterval;
   }
   else{
-    distSocket = socketItr->second;
+    m_meanService = (m_meanService*7+calcInterval)/8;
   }
-  int sendSize = distSocket->Send(rePacket);
-  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> send a packet to "<<InetSocketAddress::ConvertFrom(peer).GetIpv4()<<" size: "<<sendSize);
-  m_txTrace(rePacket);
-  m_isBusy = false;
-  if(m_jobQueue.IsEmpty()){
-    return;
+  MyHopTag tag;
+  packet->RemovePacketTag(tag);
+  tag.SetStart(Simulator::Now());
+  packet->AddPacketTag(tag);
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> start...");
+  m_sendEvent = Simulator::Schedule (calcInterval, &MyTcpServer::Complete, this, packet);
+}
+
+void MyTcpServer::Complete(Ptr<Packet> packet){
+  NS_LOG_FUNCTION(this);
+  MyHopTag tag;
+  packet->RemovePacketTag(tag);
+  MyHop hop{GetNode()->GetId(), tag.GetRx(), tag.GetStart(), Simulator::Now()};
+  auto json = hop.AppendTo(MyMessage::Parse(packet));
+  uint32_t size = GetOutputSize(packet->GetSize());
+  packet = MyMessage::CreateFrame(json.dump(), size);
+  CacheResult(json);
+  if(json["Offload"].is_object()){
+    // a job offloaded by a peer goes on to the next service of that peer
+    json11::Json::object obj = json.object_items();
+    json11::Json next = obj["Offload"]["Next"];
+    obj.erase("Offload");
+    if(next.is_object()){
+      Ipv4Address nAddr(next["Address"].string_value().c_str());
+      Forward(InetSocketAddress(nAddr, next["Port"].int_value()), MyMessage::CreateFrame(json11::Json(obj).dump(), size));
+    }
+    else{
+      Response(MyMessage::CreateFrame(json11::Json(obj).dump(), size), json11::Json(obj));
+    }
+  }
+  else if(m_nextServiceSocket.empty()){
+    Response(packet, json);
   }
   else{
-    m_isBusy = true;
+    SendNext(packet, json);
+  }
+  m_isBusy = false;
+  if(!m_jobQueue.IsEmpty()){
     Ptr<MyAppQueueItem> item = m_jobQueue.Dequeue();
     NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> dequeue... (size: "<<m_jobQueue.GetCurrentSize()<<"/"<<m_jobQueue.GetMaxPackets()<<")");
-    Time calcInterval = MicroSeconds(m_calctime->GetValue());
-    m_serviceTrace(calcInterval);
-    NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> start...");
-    m_sendEvent = Simulator::Schedule (calcInterval, &MyTcpServer::Response, this, item->GetPacket());
+    StartJob(item->GetPacket());
+  }
+  else if(m_isDraining){
+    StopDrained();
+  }
+}
+
+void MyTcpServer::Response(Ptr<Packet> packet, const json11::Json& json){
+  NS_LOG_FUNCTION(this);
+  //TODO
+  //you can add the logic to create response packet
+  if(json["Members"].is_array()){
+    // fan the response of an aggregate out to the original actuators, sharing its size
+    uint32_t size = packet->GetSize()/json["Members"].array_items().size();
+    for(auto member: json["Members"].array_items()){
+      SendResponse(ActuatorOf(member), MyMessage::CreateFrame(member.dump(), size));
+    }
+  }
+  else{
+    SendResponse(ActuatorOf(json), packet);
   }
 }
 
-void MyTcpServer::SendNext(Ptr<Packet> packet){
+void MyTcpServer::SendResponse(Address peer, Ptr<Packet> packet){
+  NS_LOG_FUNCTION(this << peer);
+  Ptr<Packet> rePacket = packet;
+
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> get actuator address "<<InetSocketAddress::ConvertFrom(peer).GetIpv4()<<" port "<<InetSocketAddress::ConvertFrom(peer).GetPort());
+
+  int sendSize = GetPeerSocket(peer)->Send(rePacket);
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> send a packet to "<<InetSocketAddress::ConvertFrom(peer).GetIpv4()<<" size: "<<sendSize);
+  m_txTrace(rePacket);
+}
+
+void MyTcpServer::SendNext(Ptr<Packet> packet, const json11::Json& json){
   NS_LOG_FUNCTION(this);
   //TODO
   //you can add the logic to create response packet
   //Ptr<Packet> rePacket = Create<Packet>(m_pktSize);
-  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> parse packet");
-  Address next = ParseSource(PacketDeserialize(packet));
+  Address next = SourceOf(json);
   NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> start to send a packet from "<< InetSocketAddress::ConvertFrom(next).GetIpv4());
+  if(m_aggCount>1){
+    Aggregate(m_addrTable[next], packet);
+  }
+  else{
+    Forward(m_addrTable[next], packet);
+  }
+}
+
+void MyTcpServer::Forward(Address nextService, Ptr<Packet> packet){
+  NS_LOG_FUNCTION(this << nextService);
   Ptr<Packet> rePacket = packet;
-  int sendSize = m_nextServiceSocket[m_addrTable[next]]->Send(rePacket);
+  auto socketItr = m_nextServiceSocket.find(nextService);
+  Ptr<Socket> nextSocket = socketItr!=m_nextServiceSocket.end() ? socketItr->second : GetPeerSocket(nextService);
+  int sendSize = nextSocket->Send(rePacket);
 
-  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> send a packet to "<<InetSocketAddress::ConvertFrom(m_addrTable[next]).GetIpv4()<<" size: "<<sendSize);
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> send a packet to "<<InetSocketAddress::ConvertFrom(nextService).GetIpv4()<<" size: "<<sendSize);
   m_txTrace(rePacket);
-  m_isBusy = false;
-  if(m_jobQueue.IsEmpty()){
+}
+
+void MyTcpServer::Aggregate(Address nextService, Ptr<Packet> packet){
+  NS_LOG_FUNCTION(this << nextService);
+  std::vector<Ptr<Packet>>& members = m_aggBuff[nextService];
+  members.push_back(packet);
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> aggregate "<<members.size()<<"/"<<m_aggCount);
+  if(members.size()>=m_aggCount){
+    FlushAggregate(nextService);
+  }
+  else if(members.size()==1 && !m_aggWindow.IsZero()){
+    m_aggEvent[nextService] = Simulator::Schedule(m_aggWindow, &MyTcpServer::FlushAggregate, this, nextService);
+  }
+}
+
+void MyTcpServer::FlushAggregate(Address nextService){
+  NS_LOG_FUNCTION(this << nextService);
+  Simulator::Cancel(m_aggEvent[nextService]);
+  std::vector<Ptr<Packet>> packets;
+  packets.swap(m_aggBuff[nextService]);
+  if(packets.empty()){
     return;
   }
-  else{
-    m_isBusy = true;
-    Ptr<MyAppQueueItem> item = m_jobQueue.Dequeue();
-    NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> dequeue... (size: "<<m_jobQueue.GetCurrentSize()<<"/"<<m_jobQueue.GetMaxPackets()<<")");
-    Time calcInterval = MicroSeconds(m_calctime->GetValue());
-    m_serviceTrace(calcInterval);
-    NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> start...");
-    m_sendEvent = Simulator::Schedule (calcInterval, &MyTcpServer::SendNext, this, item->GetPacket());
+
+  // an aggregate received from a lower layer is flattened, so that the last
+  // service can fan the response out to every original actuator
+  json11::Json::array members;
+  uint32_t nRequest = 0;
+  uint64_t size = 0;
+  for(auto p: packets){
+    size += p->GetSize();
+    auto json = MyMessage::Parse(p);
+    if(json["Members"].is_array()){
+      for(auto member: json["Members"].array_items()){
+        members.push_back(member);
+      }
+      nRequest += json["Members"].array_items().size();
+    }
+    else{
+      members.push_back(json);
+      nRequest++;
+    }
   }
+  json11::Json obj = json11::Json::object({
+    {"NodeId", members[0]["NodeId"]},
+    {"Members", members},
+  });
+
+  // the size on the links is a share of the merged messages, padded after the text
+  Ptr<Packet> rePacket = MyMessage::CreateFrame(obj.dump(), m_aggRatio*size);
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> merge "<<nRequest<<" requests of "<<size<<" bytes into "<<rePacket->GetSize()<<" bytes");
+  Forward(nextService, rePacket);
 }
 
 void MyTcpServer::HandlePeerClose (Ptr<Socket> socket)
@@ -347,26 +604,313 @@ void MyTcpServer::SetAddressTable(std::map<Address, Address> addrTable){
   m_addrTable = addrTable;
 }
 
-std::string MyTcpServer::PacketDeserialize(Ptr<Packet> p){
-  uint8_t buf[m_pktSize];
-  p->CopyData(buf, m_pktSize);
-  std::stringstream text;
-  text << buf;
-  return text.str();
+void MyTcpServer::UpdateAddressTable(std::map<Address, Address> addrTable){
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> update address table (size: "<<addrTable.size()<<")");
+  m_addrTable = addrTable;
+  if(m_socket){
+    ConnectNextServices();
+  }
+}
+
+void MyTcpServer::Drain(){
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> drain "<<GetNJobs()<<" jobs");
+  m_isDraining = true;
+  Simulator::Cancel(m_stealEvent);
+  if(GetNJobs()==0){
+    StopDrained();
+  }
+}
+
+void MyTcpServer::StopDrained(){
+  if(m_isDrained){
+    return;
+  }
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> drained");
+  // the service has moved, so the listener and the load reports go now
+  // instead of at the stop time of the application
+  m_isDrained = true;
+  Simulator::Cancel(m_stopEvent);
+  StopApplication();
+}
+
+bool MyTcpServer::IsDraining() const{
+  return m_isDraining;
+}
+
+Time MyTcpServer::GetMeanServiceTime() const{
+  return m_meanService;
+}
+
+uint64_t MyTcpServer::GetNRequests() const{
+  return m_nRequests;
+}
+
+int64_t MyTcpServer::AssignStreams(int64_t stream){
+  NS_LOG_FUNCTION(this << stream);
+  m_calctime->SetStream(stream);
+  if(m_outputSize){
+    m_outputSize->SetStream(stream + 1);
+  }
+  m_stealRng->SetStream(stream + 2);
+  return 3;
 }
 
 Address MyTcpServer::ParseActuator(std::string data){
   std::string err;
   auto json = json11::Json::parse(data, err);
-  Ipv4Address aAddr(json["ActuatorId"]["Address"].string_value().c_str());
-  return InetSocketAddress(aAddr, json["ActuatorId"]["Port"].int_value());
+  return ActuatorOf(json);
 }
 
 Address MyTcpServer::ParseSource(std::string data){
   std::string err;
   auto json = json11::Json::parse(data, err);
-  Ipv4Address aAddr(json["NodeId"]["Address"].string_value().c_str());
-  return InetSocketAddress(aAddr);
+  return SourceOf(json);
+}
+
+uint32_t MyTcpServer::GetOutputSize(uint32_t inputSize){
+  if(m_outputSize){
+    return m_outputSize->GetInteger();
+  }
+  return m_outputRatio*inputSize;
+}
+
+uint64_t MyTcpServer::GetCacheKey(const json11::Json& json){
+  std::string key;
+  switch(m_cacheKey){
+    case CACHE_SOURCE:
+      key = json["NodeId"].dump();
+      break;
+    case CACHE_ACTUATOR:
+      // the actuator of the client, not the one of an aggregate source
+      key = json["LogicalActuator"].is_object() ? json["LogicalActuator"].dump() : json["ActuatorId"].dump();
+      break;
+    case CACHE_PAYLOAD:
+      {
+        // the content only, so that clients asking for the same key share the entry
+        if(json["Key"].is_number()){
+          return std::hash<int>()(json["Key"].int_value());
+        }
+        json11::Json::object payload = json.object_items();
+        for(auto field: {"NodeId", "ActuatorId", "LogicalActuator", "Total", "Id", "Created", "Hops", "Offload"}){
+          payload.erase(field);
+        }
+        key = json11::Json(payload).dump();
+      }
+      break;
+  }
+  return std::hash<std::string>()(key);
+}
+
+void MyTcpServer::CacheResult(const json11::Json& json){
+  if(m_cacheSize==0){
+    return;
+  }
+  if(json["Members"].is_array()){
+    return;
+  }
+  m_cache.Insert(GetCacheKey(json));
+}
+
+Ptr<Socket> MyTcpServer::GetPeerSocket(Address peer){
+  auto socketItr = m_peerSockets.find(peer);
+  if(socketItr!=m_peerSockets.end()){
+    return socketItr->second;
+  }
+  Ptr<Socket> s = CreateSocket(peer);
+  m_peerSockets[peer] = s;
+  return s;
+}
+
+void MyTcpServer::AddPeer(uint32_t nodeId, Address service, Address load, uint32_t distance){
+  NS_LOG_FUNCTION(this << nodeId << service << load << distance);
+  Peer peer;
+  peer.service = service;
+  peer.load = load;
+  peer.distance = distance;
+  peer.nJob = 0;
+  peer.known = false;
+  peer.stolen = Seconds(0);
+  peer.stealPending = false;
+  m_peers[nodeId] = peer;
+}
+
+bool MyTcpServer::IsKnown(const Peer& peer) const{
+  return peer.known && Simulator::Now()-peer.updated<m_loadTimeout;
+}
+
+uint32_t MyTcpServer::GetNJobs() const{
+  return m_jobQueue.GetNPackets()+(m_isBusy ? 1 : 0);
+}
+
+bool MyTcpServer::Offload(Ptr<Packet> packet){
+  NS_LOG_FUNCTION(this);
+  if(m_offloadThreshold==0 && m_offloadWait.IsZero()){
+    return false;
+  }
+  uint32_t nJob = GetNJobs();
+  bool isOverloaded = (m_offloadThreshold>0 && nJob>=m_offloadThreshold)
+                      || (!m_offloadWait.IsZero() && m_meanService*nJob>=m_offloadWait);
+  if(!isOverloaded){
+    return false;
+  }
+
+  // the least loaded peer, the nearer one if loads are equal
+  Peer* target = 0;
+  for(auto& i: m_peers){
+    Peer& peer = i.second;
+    if(!IsKnown(peer) || peer.nJob+1>=nJob){
+      continue;
+    }
+    if(!target || peer.nJob<target->nJob || (peer.nJob==target->nJob && peer.distance<target->distance)){
+      target = &peer;
+    }
+  }
+  if(!target){
+    return false;
+  }
+
+  auto json = MyMessage::Parse(packet);
+  if(json["Offload"].is_object() || json["Members"].is_array()){
+    // offloaded jobs are never offloaded again, aggregates stay in place
+    return false;
+  }
+  SendToPeer(*target, json, packet->GetSize());
+  // count the job until the next report of the peer
+  target->nJob++;
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> offload a job to "<<InetSocketAddress::ConvertFrom(target->service).GetIpv4()<<" (load "<<nJob<<" -> "<<target->nJob<<")");
+  return true;
+}
+
+void MyTcpServer::SendToPeer(Peer& peer, const json11::Json& json, uint32_t size){
+  NS_LOG_FUNCTION(this);
+  json11::Json::object offload;
+  if(!m_nextServiceSocket.empty()){
+    InetSocketAddress next = InetSocketAddress::ConvertFrom(m_addrTable[SourceOf(json)]);
+    std::stringstream nAddr;
+    nAddr << next.GetIpv4();
+    offload["Next"] = json11::Json::object({
+      {"Address", nAddr.str()},
+      {"Port", next.GetPort()},
+    });
+  }
+  offload["From"] = static_cast<int>(GetNode()->GetId());
+  json11::Json::object obj = json.object_items();
+  obj["Offload"] = offload;
+
+  Ptr<Packet> rePacket = MyMessage::CreateFrame(json11::Json(obj).dump(), size);
+  GetPeerSocket(peer.service)->Send(rePacket);
+  m_offloadTrace(rePacket);
+  m_txTrace(rePacket);
+}
+
+void MyTcpServer::TrySteal(){
+  NS_LOG_FUNCTION(this);
+  m_stealEvent = Simulator::Schedule(m_stealInterval, &MyTcpServer::TrySteal, this);
+  if(m_isDraining || m_isBusy || !m_jobQueue.IsEmpty()){
+    return;
+  }
+
+  // a single steal request per peer until its job comes or the timeout
+  std::vector<Peer*> victims;
+  for(auto& i: m_peers){
+    Peer& peer = i.second;
+    if(peer.stealPending && peer.stolen+m_stealTimeout<=Simulator::Now()){
+      peer.stealPending = false;
+    }
+    if(IsKnown(peer) && peer.nJob>=m_stealThreshold && !peer.stealPending){
+      victims.push_back(&peer);
+    }
+  }
+  if(victims.empty()){
+    return;
+  }
+  Peer* victim = victims[0];
+  switch(m_stealPolicy){
+    case STEAL_RANDOM:
+      victim = victims[m_stealRng->GetInteger(0, victims.size()-1)];
+      break;
+    case STEAL_LEAST_RECENT:
+      for(Peer* peer: victims){
+        if(peer->stolen<victim->stolen){
+          victim = peer;
+        }
+      }
+      break;
+    case STEAL_NEAREST:
+      for(Peer* peer: victims){
+        if(peer->distance<victim->distance || (peer->distance==victim->distance && peer->nJob>victim->nJob)){
+          victim = peer;
+        }
+      }
+      break;
+  }
+  victim->stolen = Simulator::Now();
+  victim->stealPending = true;
+  json11::Json obj = json11::Json::object({
+    {"Node", static_cast<int>(GetNode()->GetId())},
+    {"Steal", static_cast<int>(m_stealThreshold)},
+  });
+  std::string data = obj.dump();
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> try to steal a job from "<<InetSocketAddress::ConvertFrom(victim->service).GetIpv4());
+  m_loadSocket->SendTo(Create<Packet>((uint8_t*)data.c_str(), data.size()), 0, victim->load);
+}
+
+void MyTcpServer::HandleSteal(Peer& thief, uint32_t threshold){
+  NS_LOG_FUNCTION(this << threshold);
+  // the job in service stays, only waiting jobs can be stolen
+  if(m_jobQueue.IsEmpty() || GetNJobs()<threshold){
+    return;
+  }
+  Ptr<Packet> packet = m_jobQueue.Peek()->GetPacket();
+  auto json = MyMessage::Parse(packet);
+  if(json["Offload"].is_object() || json["Members"].is_array()){
+    return;
+  }
+  m_jobQueue.Dequeue();
+  NS_LOG_DEBUG("MyTcpServer("<<m_nodeAddress<<") >> a job is stolen by "<<InetSocketAddress::ConvertFrom(thief.service).GetIpv4());
+  SendToPeer(thief, json, packet->GetSize());
+}
+
+void MyTcpServer::ReportLoad(){
+  NS_LOG_FUNCTION(this);
+  // a draining server reports a full queue so that peers stop offloading to it
+  uint32_t nJob = m_isDraining ? m_jobQueue.GetMaxPackets() : GetNJobs();
+  // reports are sent even if the load did not change, so that idle peers
+  // are known and the estimates of offloaded jobs are corrected
+  json11::Json obj = json11::Json::object({
+    {"Node", static_cast<int>(GetNode()->GetId())},
+    {"Load", static_cast<int>(nJob)},
+    {"Wait", static_cast<double>((m_meanService*nJob).GetMicroSeconds())},
+  });
+  std::string data = obj.dump();
+  for(auto& i: m_peers){
+    Ptr<Packet> p = Create<Packet>((uint8_t*)data.c_str(), data.size());
+    m_loadSocket->SendTo(p, 0, i.second.load);
+  }
+  m_loadEvent = Simulator::Schedule(m_loadInterval, &MyTcpServer::ReportLoad, this);
+}
+
+void MyTcpServer::HandleLoad(Ptr<Socket> socket){
+  NS_LOG_FUNCTION(this << socket);
+  Ptr<Packet> packet;
+  Address from;
+  while((packet = socket->RecvFrom(from))){
+    std::vector<uint8_t> buf(packet->GetSize());
+    packet->CopyData(buf.data(), buf.size());
+    std::string err;
+    auto json = json11::Json::parse(std::string(buf.begin(), buf.end()), err);
+    auto peerItr = m_peers.find(json["Node"].int_value());
+    if(peerItr==m_peers.end()){
+      continue;
+    }
+    if(json["Steal"].is_number()){
+      HandleSteal(peerItr->second, json["Steal"].int_value());
+      continue;
+    }
+    peerItr->second.nJob = json["Load"].int_value();
+    peerItr->second.known = true;
+    peerItr->second.updated = Simulator::Now();
+  }
 }
 
 Ptr<Socket> MyTcpServer::CreateSocket(Address peer)
@@ -23,21 +23,28 @@
 
 #include <map>
 #include <array>
+#include <vector>
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "ns3/data-rate.h"
 #include "ns3/address.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
 #include "ns3/drop-tail-queue.h"
 #include "ns3/my-queue-item.h"
+#include "ns3/my-result-cache.h"
+
+namespace json11 {
+class Json;
+}
 
 namespace ns3 {
 
 class Address;
 class Socket;
 class Packet;
-class RandomVariableStream;
 
 class MyTcpServer : public Application
 {
@@ -45,6 +52,22 @@ public:
   static TypeId GetTypeId (void);
   MyTcpServer ();
 
+  // field of a request used as the cache key
+  enum CacheKey
+    {
+      CACHE_SOURCE,
+      CACHE_ACTUATOR,
+      CACHE_PAYLOAD   //!< the Key of the request, or its fields without the client ones
+    };
+
+  // selection of the peer a job is stolen from
+  enum StealPolicy
+    {
+      STEAL_RANDOM,
+      STEAL_LEAST_RECENT,
+      STEAL_NEAREST
+    };
+
   virtual ~MyTcpServer ();
 
   uint64_t GetTotalRx () const;
@@ -55,6 +78,44 @@ public:
 
   void SetAddressTable(std::map<Address, Address> addrTable);
 
+  /**
+   * Replace the next services while the server is running.
+   * Connections to the new next services are opened at once.
+   */
+  void UpdateAddressTable(std::map<Address, Address> addrTable);
+
+  /**
+   * Stop taking jobs from the peers before the service is moved.
+   * Jobs which are queued or still in flight are served as usual, and the
+   * server stops once it has no job left.
+   */
+  void Drain();
+  bool IsDraining() const;
+
+  /**
+   * Add a server of the same service which takes offloaded jobs.
+   * \param nodeId id of the peer node, which identifies its load reports
+   * \param service address of the peer service
+   * \param load address on which the peer receives load reports
+   * \param distance the number of hops to the peer
+   */
+  void AddPeer(uint32_t nodeId, Address service, Address load, uint32_t distance);
+
+  /**
+   * \return the number of queued jobs and the job in service
+   */
+  uint32_t GetNJobs() const;
+  Time GetMeanServiceTime() const;
+  uint64_t GetNRequests() const; //!< the number of received requests
+
+  /**
+   * Assign fixed random variable streams to the calculation time, the output
+   * size and the choice of the steal victim.
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned
+   */
+  int64_t AssignStreams(int64_t stream);
+
 protected:
   virtual void DoDispose (void);
 private:
@@ -77,7 +138,6 @@ private:
   // NIWA
   using MyQueue = DropTailQueue<MyAppQueueItem>;
 
-  uint32_t        m_pktSize;
   std::map<Address, Ptr<Packet>> buff;
   Ptr<RandomVariableStream>  m_calctime;      //!< rng for calc time
   bool m_isBusy; //flag that server is now busy or not
@@ -88,15 +148,86 @@ private:
   std::map<Address, Ptr<Socket>> m_peerSockets;
   EventId m_sendEvent;
 
+  // size of the output, the request to the next service or the response
+  double m_outputRatio;                   //!< output size / request size
+  Ptr<RandomVariableStream> m_outputSize; //!< [bytes], instead of the ratio if set
+
+  // aggregation of processed requests toward the same next service
+  uint32_t m_aggCount;  //!< the number of requests merged into one message
+  Time m_aggWindow;     //!< max waiting time of the first merged request
+  double m_aggRatio;    //!< size of merged message / sum of request sizes
+  std::map<Address, std::vector<Ptr<Packet>>> m_aggBuff;
+  std::map<Address, EventId> m_aggEvent;
+
+  // cache of results answered without the service time
+  uint32_t m_cacheSize; //!< the number of cached keys (0 disables the cache)
+  MyResultCache::Policy m_cachePolicy;
+  Time m_cacheTtl;
+  CacheKey m_cacheKey;
+  MyResultCache m_cache;
+
+  // offloading to servers of the same service
+  struct Peer
+  {
+    Address service;
+    Address load;
+    uint32_t distance;
+    uint32_t nJob;      //!< last reported load
+    bool known;         //!< a report has been received
+    Time updated;       //!< time of the last report
+    Time stolen;        //!< last steal request to the peer
+    bool stealPending;  //!< no job has come back since, until StealTimeout
+  };
+  uint32_t m_offloadThreshold;
+  Time m_offloadWait;
+  uint16_t m_loadPort;
+  Time m_loadInterval;
+  Time m_loadTimeout;
+  Time m_meanService; //!< moving average of the service time
+  std::map<uint32_t, Peer> m_peers;
+  Ptr<Socket> m_loadSocket;
+  EventId m_loadEvent;
+
+  // stealing of waiting jobs by idle servers
+  uint32_t m_stealThreshold;
+  Time m_stealInterval;
+  Time m_stealTimeout;
+  StealPolicy m_stealPolicy;
+  Ptr<UniformRandomVariable> m_stealRng;
+  EventId m_stealEvent;
+
+  // migration of the service
+  uint64_t m_nRequests;
+  bool m_isDraining;
+  bool m_isDrained;   //!< stopped after draining
+
   //void Response(Ptr<Packet> packet, Ptr<Socket> socket);
-  void Response(Ptr<Packet> packet);
-  void SendNext(Ptr<Packet> packet);
+  void StartJob(Ptr<Packet> packet);
+  void Complete(Ptr<Packet> packet);
+  void Response(Ptr<Packet> packet, const json11::Json& json);
+  void SendNext(Ptr<Packet> packet, const json11::Json& json);
+  void SendResponse(Address peer, Ptr<Packet> packet);
+  void Forward(Address nextService, Ptr<Packet> packet);
+  void Aggregate(Address nextService, Ptr<Packet> packet);
+  void FlushAggregate(Address nextService);
+  uint32_t GetOutputSize(uint32_t inputSize);
+  uint64_t GetCacheKey(const json11::Json& json);
+  void CacheResult(const json11::Json& json);
+  bool Offload(Ptr<Packet> packet);
+  void ReportLoad();
+  void HandleLoad(Ptr<Socket> socket);
+  bool IsKnown(const Peer& peer) const; //!< a report is younger than LoadTimeout
+  void SendToPeer(Peer& peer, const json11::Json& json, uint32_t size);
+  void TrySteal();
+  void StopDrained();
+  void HandleSteal(Peer& thief, uint32_t threshold);
+  Ptr<Socket> GetPeerSocket(Address peer);
   bool HandleRequest(Ptr<Socket> socket, const Address& from);
 
-  std::string PacketDeserialize(Ptr<Packet> packet);
   Address ParseActuator(std::string data);
   Address ParseSource(std::string data);
   Ptr<Socket> CreateSocket(Address peer);
+  void ConnectNextServices();
 
   void ConnectionSucceeded(Ptr<Socket> socket);
   void ConnectionFailed(Ptr<Socket> socket);
@@ -107,6 +238,9 @@ private:
   TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
   TracedCallback<Ptr<const Packet>> m_txTrace;
   TracedCallback<const Time &> m_serviceTrace;
+  TracedCallback<Ptr<const Packet>> m_cacheHitTrace;
+  TracedCallback<Ptr<const Packet>> m_cacheMissTrace;
+  TracedCallback<Ptr<const Packet>> m_offloadTrace;
 };
 
 } // namespace ns3
@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement a replayer of recorded request arrivals.
+
+#include <cstdlib>
+
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+
+#include "my-trace-replayer.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MyTraceReplayer");
+
+MyTraceReplayer::MyTraceReplayer (std::string path, uint32_t nClients)
+  : m_path(path),
+    m_nClients(nClients),
+    m_buffer(1<<20),
+    m_first(-1),
+    m_nReplayed(0),
+    m_nSkipped(0),
+    m_nDropped(0)
+{
+  m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+  m_file.open(path);
+  NS_ABORT_MSG_IF(!m_file, "MyTraceReplayer >> cannot open "<<path);
+}
+
+void MyTraceReplayer::AddClient(uint32_t traceClient, Ptr<MyOnOffApplication> client){
+  m_clients[traceClient] = client;
+}
+
+void MyTraceReplayer::Start(Time start, Time stop){
+  m_start = start;
+  m_stop = stop;
+  if(ReadRow()){
+    m_first = m_row.time;
+    m_event = Simulator::Schedule(m_start-Simulator::Now(), &MyTraceReplayer::Replay, this);
+  }
+}
+
+bool MyTraceReplayer::ReadRow(){
+  std::string line;
+  while(std::getline(m_file, line)){
+    const char* p = line.c_str();
+    char* end;
+    m_row.time = std::strtoll(p, &end, 10);
+    if(end==p || line[0]=='#'){
+      continue;
+    }
+    p = end;
+    m_row.client = std::strtoul(p, &end, 10);
+    NS_ABORT_MSG_IF(end==p, "MyTraceReplayer >> no client in \""<<line<<"\" of "<<m_path);
+    p = end;
+    m_row.size = std::strtoul(p, &end, 10);
+    NS_ABORT_MSG_IF(end==p, "MyTraceReplayer >> no size in \""<<line<<"\" of "<<m_path);
+    p = end;
+    m_row.key = std::strtol(p, &end, 10);
+    if(end==p){
+      m_row.key = -1;
+    }
+    return true;
+  }
+  return false;
+}
+
+void MyTraceReplayer::Replay(){
+  // every row due now, the trace may have several requests at the same time
+  do{
+    auto client = m_clients.find(m_nClients>0 ? m_row.client%m_nClients : m_row.client);
+    if(client==m_clients.end()){
+      m_nSkipped++;
+    }
+    else if(client->second->SendRequest(m_row.size, m_row.key)){
+      m_nReplayed++;
+    }
+    else{
+      m_nDropped++;
+    }
+    if(!ReadRow()){
+      NS_LOG_INFO("MyTraceReplayer >> "<<m_nReplayed<<" requests replayed, "<<m_nSkipped<<" skipped, "<<m_nDropped<<" dropped");
+      return;
+    }
+  }while(m_start+NanoSeconds(m_row.time-m_first)<=Simulator::Now());
+  Time next = m_start+NanoSeconds(m_row.time-m_first);
+  if(next<m_stop){
+    m_event = Simulator::Schedule(next-Simulator::Now(), &MyTraceReplayer::Replay, this);
+  }
+}
+
+uint64_t MyTraceReplayer::GetNReplayed() const{
+  return m_nReplayed;
+}
+
+uint64_t MyTraceReplayer::GetNSkipped() const{
+  return m_nSkipped;
+}
+
+uint64_t MyTraceReplayer::GetNDropped() const{
+  return m_nDropped;
+}
+
+} // namespace ns3
@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define a replayer of recorded request arrivals.
+
+#ifndef MY_TRACE_REPLAYER_H
+#define MY_TRACE_REPLAYER_H
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/my-onoff-application.h"
+
+namespace ns3 {
+
+/**
+ * Sends the requests of a trace file through the clients.
+ * A row is "time client size [key]", time [ns] in ascending order, and
+ * lines starting with '#' are comments. The file is read one row ahead,
+ * so a trace of any length needs constant memory and one pending event.
+ */
+class MyTraceReplayer : public SimpleRefCount<MyTraceReplayer>
+{
+public:
+  /**
+   * \param nClients with nClients > 0, client c of the trace is replayed by
+   *        the client added as c % nClients, so a trace of more clients fits
+   */
+  MyTraceReplayer (std::string path, uint32_t nClients = 0);
+
+  /**
+   * \param traceClient the client id in the trace
+   * \param client the client that sends its requests, in Replay mode
+   */
+  void AddClient(uint32_t traceClient, Ptr<MyOnOffApplication> client);
+  /**
+   * Replay the rows until stop, the first row of the trace is sent at start.
+   */
+  void Start(Time start, Time stop);
+
+  uint64_t GetNReplayed() const;
+  uint64_t GetNSkipped() const;   //!< rows of clients that are not added
+  uint64_t GetNDropped() const;   //!< rows due after their client stopped
+
+private:
+  struct Row
+  {
+    int64_t time;
+    uint32_t client;
+    uint32_t size;
+    int key;
+  };
+
+  bool ReadRow();
+  void Replay();
+
+  std::string m_path;
+  uint32_t m_nClients;
+  std::vector<char> m_buffer;
+  std::ifstream m_file;
+  std::unordered_map<uint32_t, Ptr<MyOnOffApplication>> m_clients;
+  Row m_row;
+  int64_t m_first;  //!< time of the first row [ns]
+  Time m_start;
+  Time m_stop;
+  EventId m_event;
+  uint64_t m_nReplayed;
+  uint64_t m_nSkipped;
+  uint64_t m_nDropped;
+};
+
+} // namespace ns3
+
+#endif /* MY_TRACE_REPLAYER_H */
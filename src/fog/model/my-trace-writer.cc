@@ -0,0 +1,137 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement a buffered writer of binary trace records.
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include "my-trace-writer.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MyTraceWriter");
+
+static const size_t MAX_PENDING = 4;
+
+const char MyTraceWriter::MAGIC[8] = {'M','Y','T','R','A','C','E','1'};
+
+MyTraceWriter::MyTraceWriter (std::string path, bool threaded, uint32_t bufferSize)
+  : m_threaded(threaded),
+    m_bufferSize(bufferSize),
+    m_stop(false)
+{
+  m_file = std::fopen(path.c_str(), "wb");
+  NS_ABORT_MSG_IF(!m_file, "MyTraceWriter >> cannot open "<<path);
+  // the buffers are already large
+  std::setvbuf(m_file, nullptr, _IONBF, 0);
+  uint32_t recordSize = sizeof(Record);
+  std::fwrite(MAGIC, 1, sizeof(MAGIC), m_file);
+  std::fwrite(&recordSize, sizeof(recordSize), 1, m_file);
+  m_buffer.reserve(m_bufferSize);
+  if(m_threaded){
+    m_thread = std::thread(&MyTraceWriter::Run, this);
+  }
+}
+
+MyTraceWriter::~MyTraceWriter ()
+{
+  Close();
+}
+
+void MyTraceWriter::Write(const Record& record){
+  if(!m_file){
+    NS_LOG_LOGIC("MyTraceWriter >> drop a record written after Close");
+    return;
+  }
+  m_buffer.push_back(record);
+  if(m_buffer.size()>=m_bufferSize){
+    Flush();
+  }
+}
+
+void MyTraceWriter::Write(Kind kind, uint32_t node, uint64_t request, uint32_t size, uint32_t value){
+  Record record;
+  record.time = Simulator::Now().GetNanoSeconds();
+  record.request = request;
+  record.node = node;
+  record.size = size;
+  record.value = value;
+  record.kind = kind;
+  record.pad[0] = record.pad[1] = record.pad[2] = 0;
+  Write(record);
+}
+
+void MyTraceWriter::Flush(){
+  if(m_buffer.empty() || !m_file){
+    return;
+  }
+  if(!m_threaded){
+    std::fwrite(m_buffer.data(), sizeof(Record), m_buffer.size(), m_file);
+    m_buffer.clear();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this]{ return m_pending.size()<MAX_PENDING; });
+  m_pending.push_back(std::move(m_buffer));
+  if(m_free.empty()){
+    m_buffer = std::vector<Record>();
+    m_buffer.reserve(m_bufferSize);
+  }
+  else{
+    m_buffer = std::move(m_free.back());
+    m_free.pop_back();
+  }
+  lock.unlock();
+  m_cond.notify_all();
+}
+
+void MyTraceWriter::Run(){
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(true){
+    m_cond.wait(lock, [this]{ return m_stop || !m_pending.empty(); });
+    if(m_pending.empty()){
+      break;
+    }
+    std::vector<Record> buffer = std::move(m_pending.front());
+    m_pending.pop_front();
+    lock.unlock();
+    std::fwrite(buffer.data(), sizeof(Record), buffer.size(), m_file);
+    buffer.clear();
+    lock.lock();
+    m_free.push_back(std::move(buffer));
+    m_cond.notify_all();
+  }
+}
+
+void MyTraceWriter::Close(){
+  if(!m_file){
+    return;
+  }
+  Flush();
+  if(m_threaded){
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+  }
+  std::fclose(m_file);
+  m_file = nullptr;
+}
+
+} // namespace ns3
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define a buffered writer of binary trace records.
+
+#ifndef MY_TRACE_WRITER_H
+#define MY_TRACE_WRITER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+
+namespace ns3 {
+
+/**
+ * Writes fixed-size trace records to a binary file.
+ * Records are collected in large buffers. With a writer thread, full
+ * buffers are handed over to the thread so the simulation does not wait
+ * for write(); the hand-over blocks only when several buffers are pending.
+ *
+ * File layout: the 8 byte magic "MYTRACE1", a uint32 record size, then records.
+ *
+ * The writer must stay open until the last traced event: records written
+ * after Close are dropped, so close it at Simulator::Destroy.
+ */
+class MyTraceWriter : public SimpleRefCount<MyTraceWriter>
+{
+public:
+  enum Kind
+    {
+      CLIENT_TX = 0,  //!< request sent by a client
+      CLIENT_RX = 1,  //!< response received by an actuator
+      SERVER_RX = 2,  //!< request received by a service
+      SERVER_TX = 3,  //!< request sent by a service
+      QUEUE = 4       //!< a device queue grew, value is the new length
+    };
+
+  struct Record
+  {
+    int64_t time;       //!< [ns]
+    uint64_t request;   //!< client address << 32 | sequence number
+    uint32_t node;
+    uint32_t size;      //!< packet size [bytes]
+    uint32_t value;     //!< sequence number, or queue length
+    uint8_t kind;
+    uint8_t pad[3];
+  };
+
+  /**
+   * \param path output file
+   * \param threaded write the buffers on a background thread
+   * \param bufferSize the number of records in a buffer
+   */
+  MyTraceWriter (std::string path, bool threaded, uint32_t bufferSize = 65536);
+  ~MyTraceWriter ();
+
+  void Write(const Record& record);
+  void Write(Kind kind, uint32_t node, uint64_t request, uint32_t size, uint32_t value);
+  /**
+   * Write the pending records and close the file.
+   * Later writes do nothing.
+   */
+  void Close();
+
+  static const char MAGIC[8];
+
+private:
+  void Flush();
+  void Run();
+
+  FILE* m_file;
+  bool m_threaded;
+  uint32_t m_bufferSize;
+  std::vector<Record> m_buffer;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<std::vector<Record>> m_pending;
+  std::vector<std::vector<Record>> m_free;  //!< buffers to reuse
+  bool m_stop;
+};
+
+} // namespace ns3
+
+#endif /* MY_TRACE_WRITER_H */
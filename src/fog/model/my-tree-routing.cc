@@ -0,0 +1,56 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Implement static routes of a tree topology.
+
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/node-list.h"
+#include "ns3/ipv4-static-routing-helper.h"
+
+#include "my-tree-routing.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PointToPointTreeRoutingHelper");
+
+void
+PointToPointTreeRoutingHelper::PopulateRoutingTables (PointToPointTreeHelper& tree)
+{
+  NS_ABORT_MSG_IF(!tree.HasSubtreePrefixes(), "PointToPointTreeRoutingHelper >> assign the addresses with AssignIpv4Addresses(network, mask)");
+  Ipv4StaticRoutingHelper helper;
+  uint32_t leaf = tree.GetNLayers()-1;
+  for(uint32_t id=0; id<tree.GetNNodes(); id++){
+    Ptr<Ipv4StaticRouting> routing = helper.GetStaticRouting(NodeList::GetNode(id)->GetObject<Ipv4>());
+    NS_ABORT_MSG_IF(!routing, "PointToPointTreeRoutingHelper >> node "<<id<<" has no static routing");
+    // interface 1 is the uplink of a non-root node, the others go to the children in order
+    if(id!=0){
+      routing->SetDefaultRoute(tree.GetParentAddress(id,1), 1);
+    }
+    if(tree.GetLayer(id)+1>=leaf){
+      // the links to the leaves are connected networks
+      continue;
+    }
+    std::pair<uint32_t, uint32_t> children = tree.GetChildrenRange(id,1);
+    uint32_t interface = id==0 ? 1 : 2;
+    for(uint32_t child=children.first; child<children.second; child++, interface++){
+      routing->AddNetworkRouteTo(tree.GetSubtreeNetwork(child), tree.GetSubtreeMask(child), tree.GetIpv4Address(child,1), interface);
+    }
+    NS_LOG_DEBUG("PointToPointTreeRoutingHelper >> node "<<id<<": "<<routing->GetNRoutes()<<" routes");
+  }
+}
+
+} // namespace ns3
@@ -0,0 +1,41 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Define static routes of a tree topology.
+
+#ifndef MY_TREE_ROUTING_H
+#define MY_TREE_ROUTING_H
+
+#include "ns3/my-tree.h"
+
+namespace ns3 {
+
+/**
+ * Installs static routes of a PointToPointTreeHelper in O(N) instead of
+ * Ipv4GlobalRoutingHelper::PopulateRoutingTables.
+ * Each node gets a default route to its parent and one route per child
+ * subtree, so the addresses must be assigned with
+ * PointToPointTreeHelper::AssignIpv4Addresses(Ipv4Address, Ipv4Mask).
+ */
+class PointToPointTreeRoutingHelper
+{
+public:
+  static void PopulateRoutingTables(PointToPointTreeHelper& tree);
+};
+
+} // namespace ns3
+
+#endif /* MY_TREE_ROUTING_H */
@@ -17,6 +17,8 @@
 // Implement an object to create a star topology.
 
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -32,6 +34,7 @@
 #include "ns3/core-module.h"
 
 #include "ns3/traffic-control-module.h"
+#include "ns3/mpi-interface.h"
 
 #include "my-tree.h"
 
@@ -99,38 +102,181 @@ LinkContainer LinkContainer::CreateLinkContainer(uint32_t parent){
 }
 
 // p2p
-PointToPointTreeHelper::PointToPointTreeHelper(){
+PointToPointTreeHelper::PointToPointTreeHelper()
+  : m_accessMode(LINK_P2P),
+    m_nSystems(1),
+    m_partitionLayer(0)
+{
 }
 
-PointToPointTreeHelper::PointToPointTreeHelper(std::vector<int> nodeNums, std::vector<std::string> bandwidth, std::vector<std::string> delays)
+PointToPointTreeHelper::PointToPointTreeHelper(std::vector<int> nodeNums, std::vector<std::string> bandwidth, std::vector<std::string> delays, uint32_t nSystems)
 {
-  m_nodeNums = nodeNums;
   m_bandwidths = bandwidth;
   m_delays = delays;
+  std::vector<std::vector<uint32_t>> fanout(1, std::vector<uint32_t>(1, 1));
+  for(size_t i=1;i<nodeNums.size();i++){
+    fanout.emplace_back(1, nodeNums[i]);
+  }
+  Create(fanout, nSystems);
+}
+
+PointToPointTreeHelper::PointToPointTreeHelper(std::vector<std::vector<uint32_t>> fanout, std::vector<std::string> bandwidth, std::vector<std::string> delays, uint32_t nSystems)
+{
+  m_bandwidths = bandwidth;
+  m_delays = delays;
+  Create(fanout, nSystems);
+}
+
+PointToPointTreeHelper::PointToPointTreeHelper(std::string topologyFile, uint32_t nSystems)
+{
+  std::ifstream ifs(topologyFile);
+  NS_ABORT_MSG_IF(!ifs, "PointToPointTreeHelper >> cannot open "<<topologyFile);
+  std::vector<std::vector<uint32_t>> fanout(1, std::vector<uint32_t>(1, 1));
+  std::vector<std::pair<uint32_t, uint32_t>> uplinks;
+  std::vector<std::pair<std::string, std::string>> uplinkAttributes;
+  std::string line;
+  while(std::getline(ifs, line)){
+    std::istringstream is(line.substr(0, line.find('#')));
+    std::string key;
+    uint32_t nLayer;
+    if(!(is >> key)){
+      continue;
+    }
+    NS_ABORT_MSG_IF(!(is >> nLayer), "PointToPointTreeHelper >> no layer in \""<<line<<"\"");
+    if(key=="fanout"){
+      NS_ABORT_MSG_IF(nLayer==0, "PointToPointTreeHelper >> layer 0 is the root");
+      fanout.resize(std::max<size_t>(fanout.size(), nLayer+1));
+      uint32_t n;
+      while(is >> n){
+        fanout[nLayer].push_back(n);
+      }
+    }
+    else if(key=="link"){
+      m_bandwidths.resize(std::max<size_t>(m_bandwidths.size(), nLayer+1));
+      m_delays.resize(std::max<size_t>(m_delays.size(), nLayer+1));
+      is >> m_bandwidths[nLayer] >> m_delays[nLayer];
+    }
+    else if(key=="uplink"){
+      uint32_t nNode;
+      std::string bandwidth, delay;
+      is >> nNode >> bandwidth >> delay;
+      uplinks.emplace_back(nLayer, nNode);
+      uplinkAttributes.emplace_back(bandwidth, delay);
+    }
+    else{
+      NS_FATAL_ERROR("PointToPointTreeHelper >> unknown entry \""<<line<<"\"");
+    }
+  }
+  NS_ABORT_MSG_IF(m_bandwidths.size()+1<fanout.size() || m_delays.size()+1<fanout.size(),
+                  "PointToPointTreeHelper >> a layer of "<<topologyFile<<" has no link");
+  Create(fanout, nSystems);
+  for(size_t i=0;i<uplinks.size();i++){
+    NS_ABORT_MSG_IF(uplinks[i].first==0 || uplinks[i].first>=GetNLayers() || uplinks[i].second>=GetNLayerNodes(uplinks[i].first),
+                    "PointToPointTreeHelper >> no node "<<uplinks[i].second<<" in layer "<<uplinks[i].first);
+    SetLinkAttributes(m_offset[uplinks[i].first]+uplinks[i].second, uplinkAttributes[i].first, uplinkAttributes[i].second);
+  }
+}
+
+void PointToPointTreeHelper::Create(std::vector<std::vector<uint32_t>> fanout, uint32_t nSystems)
+{
+  m_accessMode = LINK_P2P;
+  // a group is the children of a node of the layer above
+  m_offset.assign(1, 0);
+  m_groupStart.clear();
+  m_nodeNums.clear();
+  for(size_t i=0;i<fanout.size();i++){
+    uint32_t nGroups = i==0 ? 1 : m_groupStart[i-1].back();
+    NS_ABORT_MSG_IF(fanout[i].size()!=1 && fanout[i].size()!=nGroups,
+                    "PointToPointTreeHelper >> layer "<<i<<" has "<<nGroups<<" groups, not "<<fanout[i].size());
+    std::vector<uint32_t> groupStart(1, 0);
+    uint32_t largest = 0;
+    for(uint32_t j=0;j<nGroups;j++){
+      uint32_t n = fanout[i].size()==1 ? fanout[i][0] : fanout[i][j];
+      groupStart.push_back(groupStart.back()+n);
+      largest = std::max(largest, n);
+    }
+    m_groupStart.push_back(groupStart);
+    m_nodeNums.push_back(largest);
+    m_offset.push_back(m_offset.back()+groupStart.back());
+  }
+  NS_ABORT_MSG_IF(m_groupStart[0].back()!=1, "PointToPointTreeHelper >> the tree must have a single root");
+
+  std::vector<uint32_t> systems = Partition(nSystems);
 
   NodeContainer top;
   top.Create(1);
+  NS_ASSERT_MSG(top.Get(0)->GetId()==0, "PointToPointTreeHelper >> the tree must be the first nodes");
   //m_link.push_back(LinkContainer::CreateLinkContainer());
+  m_link.reserve(m_offset.back());
   m_link.emplace_back();
 
-  std::vector<NodeContainer> topLayer;
-  topLayer.push_back(top);
-  for(size_t i=1;i<m_nodeNums.size();i++){
-    std::vector<NodeContainer> layer;
-    for(size_t j=0;j<GetNGroups(i-1);j++){
-      for(int k=0; k<m_nodeNums[i-1];k++){
-        NodeContainer nodes;
-        nodes.Create(m_nodeNums[i]);
-        for(int l=0; l<m_nodeNums[i]; l++){
-          m_link.emplace_back(GetNode(i-1,j,k)->GetId());
-          m_link[GetNode(i-1,j,k)->GetId()].AddChild(nodes.Get(l)->GetId());
+  for(size_t i=1;i<GetNLayers();i++){
+    for(uint32_t parent=m_offset[i-1]; parent<m_offset[i]; parent++){
+      NodeContainer nodes;
+      uint32_t nNodes = GetNNodes(i, parent-m_offset[i-1]);
+      if(m_nSystems==1 || i<m_partitionLayer){
+        nodes.Create(nNodes);
+      }
+      else if(i==m_partitionLayer){
+        uint32_t first = m_groupStart[i][parent-m_offset[i-1]];
+        for(uint32_t l=0; l<nNodes; l++){
+          nodes.Create(1, systems[first+l]);
         }
-        layer.push_back(nodes);
+      }
+      else{
+        nodes.Create(nNodes, NodeList::GetNode(parent)->GetSystemId());
+      }
+      for(uint32_t l=0; l<nodes.GetN(); l++){
+        m_link.emplace_back(parent);
+        m_link[parent].AddChild(nodes.Get(l)->GetId());
       }
     }
   }
 }
 
+std::vector<uint32_t> PointToPointTreeHelper::Partition(uint32_t nSystems)
+{
+  m_nSystems = nSystems;
+  m_partitionLayer = 0;
+  std::vector<uint32_t> systems;
+  if(nSystems<=1){
+    m_nSystems = 1;
+    return systems;
+  }
+  // the upper links with the largest delay, below which there are enough subtrees
+  for(uint32_t i=1;i<GetNLayers();i++){
+    if(GetNLayerNodes(i)<nSystems){
+      continue;
+    }
+    if(m_partitionLayer==0 || Time(m_delays[i-1])>Time(m_delays[m_partitionLayer-1])){
+      m_partitionLayer = i;
+    }
+  }
+  NS_ABORT_MSG_IF(m_partitionLayer==0, "PointToPointTreeHelper >> no layer has "<<nSystems<<" subtrees");
+
+  // contiguous runs of subtrees with about the same number of leaves
+  uint32_t leaf = GetNLayers()-1;
+  uint32_t nSubtrees = GetNLayerNodes(m_partitionLayer);
+  std::vector<uint32_t> leaves(nSubtrees, 1);
+  for(uint32_t i=0;i<nSubtrees;i++){
+    uint32_t first = i, last = i+1;
+    for(uint32_t l=m_partitionLayer+1; l<=leaf; l++){
+      first = m_groupStart[l][first];
+      last = m_groupStart[l][last];
+    }
+    leaves[i] = last-first;
+  }
+  uint64_t total = std::max<uint64_t>(m_groupStart[leaf].back(), 1);
+  uint64_t seen = 0;
+  for(uint32_t i=0;i<nSubtrees;i++){
+    // the system in which the middle leaf of the subtree falls
+    systems.push_back(std::min<uint64_t>((2*seen+leaves[i])*nSystems/(2*total), nSystems-1));
+    seen += leaves[i];
+  }
+  NS_LOG_INFO("PointToPointTreeHelper >> "<<nSubtrees<<" subtrees of layer "<<m_partitionLayer<<" on "<<nSystems<<" systems");
+  return systems;
+}
+
 PointToPointTreeHelper::~PointToPointTreeHelper ()
 {
 }
@@ -144,12 +290,23 @@ PointToPointTreeHelper::GetNode (uint32_t nLayer, uint32_t nGroup, uint32_t nNod
 Ipv4Address
 PointToPointTreeHelper::GetIpv4Address (uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t nInterface)
 {
-  return GetNode(nLayer,nGroup,nNode)->GetObject<Ipv4>()->GetAddress(nInterface,0).GetLocal();
+  return GetIpv4Address(GetNodeId(nLayer,nGroup,nNode),nInterface);
 }
 
 Ipv4Address
 PointToPointTreeHelper::GetIpv4Address (uint32_t nodeId, uint32_t nInterface)
 {
+  if(!m_upAddress.empty() && nInterface>0){
+    // interface 1 is the uplink of a non-root node, the others go to the children in order
+    uint32_t nChild = nodeId==0 ? nInterface-1 : nInterface-2;
+    if(nodeId>0 && nInterface==1){
+      return m_upAddress[nodeId];
+    }
+    std::pair<uint32_t, uint32_t> children = GetChildrenRange(nodeId,1);
+    if(children.first+nChild<children.second){
+      return m_downAddress[children.first+nChild];
+    }
+  }
   return NodeList::GetNode(nodeId)->GetObject<Ipv4>()->GetAddress(nInterface,0).GetLocal();
 }
 
@@ -159,35 +316,297 @@ PointToPointTreeHelper::InstallStack (InternetStackHelper stack)
   stack.InstallAll();
 }
 
+PointToPointHelper
+PointToPointTreeHelper::GetLinkHelper (uint32_t nLayer)
+{
+  PointToPointHelper p2p;
+  p2p.SetQueue("ns3::DropTailQueue", "MaxSize", StringValue (GetDeviceQueueSize(nLayer)));
+  p2p.SetDeviceAttribute("DataRate", StringValue(m_bandwidths[nLayer]));
+  p2p.SetChannelAttribute("Delay", StringValue(m_delays[nLayer]));
+  return p2p;
+}
+
+Ipv4InterfaceContainer
+PointToPointTreeHelper::InstallLink (PointToPointHelper& p2p, uint32_t parent, uint32_t child, Ipv4AddressHelper& address)
+{
+  NetDeviceContainer device;
+  auto uplink = m_uplink.find(child);
+  if(uplink!=m_uplink.end()){
+    PointToPointHelper custom = p2p;
+    custom.SetDeviceAttribute("DataRate", StringValue(uplink->second.first));
+    custom.SetChannelAttribute("Delay", StringValue(uplink->second.second));
+    device = custom.Install(NodeList::GetNode(parent),NodeList::GetNode(child));
+  }
+  else{
+    device = p2p.Install(NodeList::GetNode(parent),NodeList::GetNode(child));
+  }
+  bool queueDisc = m_accessMode==LINK_P2P || !IsAccessLink(child);
+  if(queueDisc){
+    InstallQueueDisc(GetLayer(parent), device);
+  }
+  Ipv4InterfaceContainer interface = address.Assign(device);
+  if(!queueDisc){
+    // Assign installs the default queue disc on a device without one
+    TrafficControlHelper tch;
+    tch.Uninstall (device);
+  }
+  m_downAddress[child] = interface.GetAddress(0);
+  m_upAddress[child] = interface.GetAddress(1);
+  return interface;
+}
+
+void
+PointToPointTreeHelper::InstallGroup (uint32_t parent, Ipv4AddressHelper& address)
+{
+  uint32_t nLayer = GetLayer(parent);
+  NS_ABORT_MSG_IF(m_nSystems>1 && m_partitionLayer==nLayer+1,
+                  "PointToPointTreeHelper >> a shared channel cannot span the systems of the partition layer");
+  std::pair<uint32_t, uint32_t> children = GetChildrenRange(parent,1);
+  if(children.first==children.second){
+    return;
+  }
+  NodeContainer nodes(NodeList::GetNode(parent));
+  for(uint32_t child=children.first; child<children.second; child++){
+    if(m_uplink.count(child)){
+      NS_LOG_WARN("PointToPointTreeHelper >> the uplink of node "<<child<<" is the shared channel of its group");
+    }
+    nodes.Add(NodeList::GetNode(child));
+  }
+  CsmaHelper csma;
+  csma.SetQueue("ns3::DropTailQueue", "MaxSize", StringValue (GetDeviceQueueSize(nLayer)));
+  csma.SetChannelAttribute("DataRate", StringValue(m_bandwidths[nLayer]));
+  csma.SetChannelAttribute("Delay", StringValue(m_delays[nLayer]));
+  NetDeviceContainer devices = csma.Install(nodes);
+  // a queue disc on the parent only, the leaves send little
+  InstallQueueDisc(nLayer, NetDeviceContainer(devices.Get(0)));
+  Ipv4InterfaceContainer interfaces = address.Assign(devices);
+  NetDeviceContainer leaves;
+  for(uint32_t i=1; i<devices.GetN(); i++){
+    leaves.Add(devices.Get(i));
+  }
+  TrafficControlHelper tch;
+  tch.Uninstall (leaves);
+  for(uint32_t child=children.first; child<children.second; child++){
+    m_downAddress[child] = interfaces.GetAddress(0);
+    m_upAddress[child] = interfaces.GetAddress(child-children.first+1);
+  }
+}
+
+void
+PointToPointTreeHelper::SetQueueDisc (uint32_t nLayer, std::string queueDisc, std::string deviceQueue, bool bql)
+{
+  NS_ABORT_MSG_IF(nLayer+1>=GetNLayers(), "PointToPointTreeHelper >> no links below layer "<<nLayer);
+  // "Type[Name=Value|Name=Value]", as the attribute strings of random variables
+  QueueDiscConfig config;
+  size_t open = queueDisc.find('[');
+  config.type = queueDisc.substr(0, open);
+  if(open!=std::string::npos){
+    size_t close = queueDisc.rfind(']');
+    NS_ABORT_MSG_IF(close==std::string::npos || close<open, "PointToPointTreeHelper >> no ']' in "<<queueDisc);
+    std::istringstream is(queueDisc.substr(open+1, close-open-1));
+    std::string attribute;
+    while(std::getline(is, attribute, '|')){
+      size_t eq = attribute.find('=');
+      NS_ABORT_MSG_IF(eq==std::string::npos, "PointToPointTreeHelper >> no value of "<<attribute<<" in "<<queueDisc);
+      config.attributes.emplace_back(attribute.substr(0, eq), attribute.substr(eq+1));
+    }
+  }
+  config.deviceQueue = deviceQueue;
+  config.bql = bql;
+  m_queueDisc[nLayer] = config;
+}
+
+std::string
+PointToPointTreeHelper::GetDeviceQueueSize (uint32_t nLayer)
+{
+  auto config = m_queueDisc.find(nLayer);
+  return config==m_queueDisc.end() ? "10000000p" : config->second.deviceQueue;
+}
+
+void
+PointToPointTreeHelper::InstallQueueDisc (uint32_t nLayer, NetDeviceContainer devices)
+{
+  TrafficControlHelper tch;
+  auto config = m_queueDisc.find(nLayer);
+  if(config==m_queueDisc.end()){
+    tch.SetRootQueueDisc ("ns3::PfifoFastQueueDisc", "MaxSize", StringValue ("10000000p"));
+    tch.Install (devices);
+    return;
+  }
+  uint16_t handle = tch.SetRootQueueDisc (config->second.type);
+  if(config->second.type=="ns3::FqCoDelQueueDisc"){
+    tch.AddPacketFilter (handle, "ns3::FqCoDelIpv4PacketFilter");
+  }
+  if(config->second.bql){
+    tch.SetQueueLimits ("ns3::DynamicQueueLimits");
+  }
+  QueueDiscContainer queueDiscs = tch.Install (devices);
+  // the queues of a queue disc are created when the node is initialized
+  for(uint32_t i=0; i<queueDiscs.GetN(); i++){
+    for(auto& attribute: config->second.attributes){
+      queueDiscs.Get(i)->SetAttribute(attribute.first, StringValue(attribute.second));
+    }
+  }
+}
+
+bool
+PointToPointTreeHelper::IsAccessLink (uint32_t child)
+{
+  return GetLayer(child)+1==GetNLayers();
+}
+
+void
+PointToPointTreeHelper::SetAccessLinkMode (LinkMode mode)
+{
+  m_accessMode = mode;
+}
+
+PointToPointTreeHelper::LinkMode
+PointToPointTreeHelper::GetAccessLinkMode ()
+{
+  return m_accessMode;
+}
+
+void
+PointToPointTreeHelper::ReportMemory (std::ostream& os)
+{
+  static const char* MODE[] = {"p2p", "p2p-no-tc", "csma-shared"};
+  uint64_t nNodes = 0;
+  uint64_t nDevices = 0;
+  uint64_t nQueueDiscs = 0;
+  for(uint32_t id=0; id<m_offset.back(); id++){
+    if(!IsLocal(id)){
+      continue;
+    }
+    Ptr<Node> node = NodeList::GetNode(id);
+    Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+    nNodes++;
+    for(uint32_t d=0; d<node->GetNDevices(); d++){
+      nDevices++;
+      if(tc && tc->GetRootQueueDiscOnDevice(node->GetDevice(d))){
+        nQueueDiscs++;
+      }
+    }
+  }
+  // resident and peak resident memory [kB], Linux only
+  uint64_t rss = 0;
+  uint64_t peak = 0;
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while(std::getline(status, line)){
+    std::istringstream is(line);
+    std::string key;
+    is >> key;
+    if(key=="VmRSS:"){
+      is >> rss;
+    }
+    else if(key=="VmHWM:"){
+      is >> peak;
+    }
+  }
+  os << "# mode nodes devices queue-discs rss[kB] peak-rss[kB]\n";
+  os << MODE[m_accessMode] << " " << nNodes << " " << nDevices << " " << nQueueDiscs
+     << " " << rss << " " << peak << "\n";
+  os.flush();
+}
+
 void 
 PointToPointTreeHelper::AssignIpv4Addresses (Ipv4AddressHelper address)
 {
-  std::ofstream ifs("myNodeList.csv");
-  ifs<<"fromN fromA toN toA"<<std::endl;
+  NS_ABORT_MSG_IF(m_accessMode==LINK_CSMA_SHARED,
+                  "PointToPointTreeHelper >> shared channels need AssignIpv4Addresses(network, mask)");
+  m_upAddress.assign(m_offset.back(), Ipv4Address());
+  m_downAddress.assign(m_offset.back(), Ipv4Address());
 
   for(size_t nLayer=0; nLayer<(GetNLayers()-1); nLayer++){
-    PointToPointHelper p2p;
-    p2p.SetQueue("ns3::DropTailQueue", "MaxSize", StringValue ("10000000p"));
-    p2p.SetDeviceAttribute("DataRate", StringValue(m_bandwidths[nLayer]));
-    p2p.SetChannelAttribute("Delay", StringValue(m_delays[nLayer]));
-    TrafficControlHelper tch;
-    tch.SetRootQueueDisc ("ns3::PfifoFastQueueDisc", "MaxSize", StringValue ("10000000p"));
-    for(size_t nGroup=0; nGroup<GetNGroups(nLayer); nGroup++){
-      for(size_t nNode=0; nNode<GetNNodes(nLayer,nGroup); nNode++){
-        for(int i=0; i<m_nodeNums[nLayer+1]; i++){
-          Ptr<Node> fromNode = GetNode(nLayer, nGroup, nNode);
-          Ptr<Node> toNode = GetNode(nLayer+1, nGroup*GetNNodes(nLayer,nGroup)+nNode, i);
-          NetDeviceContainer device = p2p.Install(fromNode,toNode);
-          tch.Install (device);
-          Ipv4InterfaceContainer interface = address.Assign(device);
-          ifs <<fromNode->GetId()<<" "<<InetSocketAddress(interface.GetAddress(0)).GetIpv4()<<" "
-              <<toNode->GetId()<<" "<<InetSocketAddress(interface.GetAddress(1)).GetIpv4()<<std::endl;
-          address.NewNetwork();
-        }
+    PointToPointHelper p2p = GetLinkHelper(nLayer);
+    for(uint32_t parent=m_offset[nLayer]; parent<m_offset[nLayer+1]; parent++){
+      std::pair<uint32_t, uint32_t> children = GetChildrenRange(parent,1);
+      for(uint32_t child=children.first; child<children.second; child++){
+        InstallLink(p2p, parent, child, address);
+        address.NewNetwork();
       }
     }
   }
-  ifs.close();
+}
+
+void
+PointToPointTreeHelper::AssignIpv4Addresses (Ipv4Address network, Ipv4Mask mask)
+{
+  // a subtree holds the blocks of its children and then its own uplink,
+  // the blocks of a layer have the size of the largest group below it
+  uint32_t nLayers = GetNLayers();
+  m_blockBits.assign(nLayers, 0);
+  for(int nLayer=nLayers-2; nLayer>0; nLayer--){
+    uint64_t links = (static_cast<uint64_t>(m_nodeNums[nLayer+1])<<m_blockBits[nLayer+1])+1;
+    while((1ULL<<m_blockBits[nLayer])<links){
+      m_blockBits[nLayer]++;
+    }
+  }
+  if(nLayers>1){
+    uint64_t size = (static_cast<uint64_t>(m_nodeNums[1])<<m_blockBits[1])*4;
+    uint64_t align = 4ULL<<m_blockBits[1];
+    NS_ABORT_MSG_IF(size>(~mask.Get())+1ULL,
+                    "PointToPointTreeHelper >> "<<size<<" addresses do not fit in "<<network<<"/"<<mask.GetPrefixLength());
+    NS_ABORT_MSG_IF(network.Get()%align!=0, "PointToPointTreeHelper >> "<<network<<" is not aligned to "<<align<<" addresses");
+  }
+  m_network = network;
+  m_blockBase.assign(m_offset.back(), 0);
+
+  m_upAddress.assign(m_offset.back(), Ipv4Address());
+  m_downAddress.assign(m_offset.back(), Ipv4Address());
+  std::vector<PointToPointHelper> p2p;
+  for(size_t nLayer=0; nLayer+1<nLayers; nLayer++){
+    p2p.push_back(GetLinkHelper(nLayer));
+  }
+  // depth first, so each node installs its uplink before the links to its children
+  AssignSubtree(0, p2p);
+}
+
+void
+PointToPointTreeHelper::AssignSubtree (uint32_t nodeId, std::vector<PointToPointHelper>& p2p)
+{
+  uint32_t nLayer = GetLayer(nodeId);
+  std::pair<uint32_t, uint32_t> children = GetChildrenRange(nodeId,1);
+  if(m_accessMode==LINK_CSMA_SHARED && nLayer+2==GetNLayers()){
+    // the subnet of the group, the parent and the leaves fit in the blocks of the leaves
+    uint32_t size = 4;
+    while(size<children.second-children.first+3){
+      size <<= 1;
+    }
+    for(uint32_t child=children.first; child<children.second; child++){
+      m_blockBase[child] = m_blockBase[nodeId]+(child-children.first);
+    }
+    Ipv4AddressHelper address;
+    address.SetBase(Ipv4Address(m_network.Get()+m_blockBase[nodeId]*4), Ipv4Mask(~(size-1)));
+    InstallGroup(nodeId, address);
+    return;
+  }
+  for(uint32_t child=children.first; child<children.second; child++){
+    uint32_t childBits = m_blockBits[nLayer+1];
+    m_blockBase[child] = m_blockBase[nodeId]+((child-children.first)<<childBits);
+    // the uplink of the child follows the blocks of its own children
+    uint32_t link = m_blockBase[child];
+    if(nLayer+2<GetNLayers()){
+      link += m_nodeNums[nLayer+2]<<m_blockBits[nLayer+2];
+    }
+    Ipv4AddressHelper address;
+    address.SetBase(Ipv4Address(m_network.Get()+link*4), "255.255.255.252");
+    InstallLink(p2p[nLayer], nodeId, child, address);
+    AssignSubtree(child, p2p);
+  }
+}
+
+bool PointToPointTreeHelper::HasSubtreePrefixes(){
+  return !m_blockBase.empty();
+}
+
+Ipv4Address PointToPointTreeHelper::GetSubtreeNetwork(uint32_t nodeId){
+  return Ipv4Address(m_network.Get()+m_blockBase[nodeId]*4);
+}
+
+Ipv4Mask PointToPointTreeHelper::GetSubtreeMask(uint32_t nodeId){
+  return Ipv4Mask(~((4U<<m_blockBits[GetLayer(nodeId)])-1));
 }
 
 size_t PointToPointTreeHelper::GetNLayers(){
@@ -195,16 +614,39 @@ size_t PointToPointTreeHelper::GetNLayers(){
 }
 
 size_t PointToPointTreeHelper::GetNGroups(uint32_t nLayer){
-  uint32_t nodeNumInLayer = 1;
-  for(uint32_t i=0; i<nLayer; i++){
-    nodeNumInLayer *= m_nodeNums[i];
-  }
-  return nodeNumInLayer;
+  return m_groupStart[nLayer].size()-1;
 }
 
 size_t PointToPointTreeHelper::GetNNodes(uint32_t nLayer, uint32_t nGroup){
-  //in this time, each group has same number of nodes
-  return m_nodeNums[nLayer];
+  return m_groupStart[nLayer][nGroup+1]-m_groupStart[nLayer][nGroup];
+}
+
+size_t PointToPointTreeHelper::GetNLayerNodes(uint32_t nLayer){
+  return m_offset[nLayer+1]-m_offset[nLayer];
+}
+
+size_t PointToPointTreeHelper::GetNNodes(){
+  return m_offset.back();
+}
+
+uint32_t PointToPointTreeHelper::GetNSystems(){
+  return m_nSystems;
+}
+
+uint32_t PointToPointTreeHelper::GetPartitionLayer(){
+  return m_partitionLayer;
+}
+
+uint32_t PointToPointTreeHelper::GetSystemId(uint32_t nodeId){
+  return NodeList::GetNode(nodeId)->GetSystemId();
+}
+
+bool PointToPointTreeHelper::IsLocal(uint32_t nodeId){
+  return m_nSystems==1 || GetSystemId(nodeId)==MpiInterface::GetSystemId();
+}
+
+uint32_t PointToPointTreeHelper::GetLayer(uint32_t nodeId){
+  return std::upper_bound(m_offset.begin(), m_offset.end()-1, nodeId)-m_offset.begin()-1;
 }
 
 uint32_t PointToPointTreeHelper::GetParentId(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t parentLayer){
@@ -213,25 +655,31 @@ uint32_t PointToPointTreeHelper::GetParentId(uint32_t nLayer, uint32_t nGroup, u
 
 uint32_t PointToPointTreeHelper::GetParentId(uint32_t nodeId, uint32_t nUp){
   uint32_t id = nodeId;
-  uint32_t preId = nodeId;
   for(uint32_t i=0; i<nUp; i++){
-    preId = id;
-    id = m_link[preId].GetParent();
+    id = m_link[id].GetParent();
   }
   return id;
 }
 
+uint32_t PointToPointTreeHelper::GetGroupParentId(uint32_t nLayer, uint32_t nGroup){
+  // the groups of a layer follow the order of the nodes of the layer above
+  return m_offset[nLayer-1]+nGroup;
+}
+
 Ipv4Address PointToPointTreeHelper::GetParentAddress(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t parentLayer){
   return GetParentAddress(GetNodeId(nLayer,nGroup,nNode),nLayer-parentLayer);
 }
 
 Ipv4Address PointToPointTreeHelper::GetParentAddress(uint32_t nodeId, uint32_t nUp){
-  uint32_t id = nodeId;
-  uint32_t preId = nodeId;
-  for(uint32_t i=0; i<nUp; i++){
-    preId = id;
-    id = m_link[preId].GetParent();
+  if(nUp==0){
+    return GetIpv4Address(nodeId,1);
   }
+  // the address of the ancestor on the link towards this branch
+  uint32_t preId = GetParentId(nodeId,nUp-1);
+  if(!m_downAddress.empty()){
+    return m_downAddress[preId];
+  }
+  uint32_t id = m_link[preId].GetParent();
   if(id==0){
     return GetIpv4Address(id,m_link[id].GetNthChild(preId)+1);
   }
@@ -243,27 +691,38 @@ std::vector<uint32_t> PointToPointTreeHelper::GetChildrenId(uint32_t nLayer, uin
 }
 
 std::vector<uint32_t> PointToPointTreeHelper::GetChildrenId(uint32_t nodeId, uint32_t nDown){
-  std::vector<uint32_t> childrenList;
-  uint32_t id = nodeId;
-  if(nDown==1){
-    return m_link[id].GetChildren();
-  }
-  std::vector<uint32_t> children = m_link[id].GetChildren();
-  for(uint32_t i: children){
-    std::vector<uint32_t> tmpChildren = GetChildrenId(i,nDown-1);
-    std::copy(tmpChildren.begin(),tmpChildren.end(),std::back_inserter(childrenList));
+  std::pair<uint32_t, uint32_t> range = GetChildrenRange(nodeId, nDown);
+  std::vector<uint32_t> childrenList(range.second-range.first);
+  for(uint32_t i=range.first; i<range.second; i++){
+    childrenList[i-range.first] = i;
   }
   return childrenList;
 }
 
+std::pair<uint32_t, uint32_t> PointToPointTreeHelper::GetChildrenRange(uint32_t nodeId, uint32_t nDown){
+  uint32_t nLayer = GetLayer(nodeId);
+  if(nLayer+nDown>=GetNLayers()){
+    return std::make_pair(m_offset.back(), m_offset.back());
+  }
+  // the groups under the nodes [first, last) of a layer are the nodes [first, last) of the next one
+  uint32_t first = nodeId-m_offset[nLayer];
+  uint32_t last = first+1;
+  for(uint32_t i=nLayer+1; i<=nLayer+nDown; i++){
+    first = m_groupStart[i][first];
+    last = m_groupStart[i][last];
+  }
+  return std::make_pair(m_offset[nLayer+nDown]+first, m_offset[nLayer+nDown]+last);
+}
+
 std::vector<Ipv4Address> PointToPointTreeHelper::GetChildrenAddress(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t childLayer){
   return GetChildrenAddress(GetNodeId(nLayer,nGroup,nNode),childLayer-nLayer);
 }
 
 std::vector<Ipv4Address> PointToPointTreeHelper::GetChildrenAddress(uint32_t nodeId, uint32_t nDown){
-  std::vector<uint32_t> childrenList = GetChildrenId(nodeId, nDown);
+  std::pair<uint32_t, uint32_t> range = GetChildrenRange(nodeId, nDown);
   std::vector<Ipv4Address> childrenAddr;
-  for(uint32_t i: childrenList){
+  childrenAddr.reserve(range.second-range.first);
+  for(uint32_t i=range.first; i<range.second; i++){
     childrenAddr.push_back(GetIpv4Address(i,1));
   }
   return childrenAddr;
@@ -273,19 +732,117 @@ std::vector<LinkContainer> PointToPointTreeHelper::GetLinkList(){
   return m_link;
 }
 
+const char PointToPointTreeHelper::TOPOLOGY_MAGIC[8] = {'M','Y','T','O','P','O','1','\0'};
+
+PointToPointTreeHelper::Link PointToPointTreeHelper::GetLink(uint32_t child){
+  NS_ABORT_MSG_IF(child==0 || child>=m_upAddress.size(), "PointToPointTreeHelper >> no uplink of node "<<child<<" with addresses");
+  Link link;
+  link.parent = m_link[child].GetParent();
+  link.parentAddress = m_downAddress[child];
+  link.child = child;
+  link.childAddress = m_upAddress[child];
+  link.dataRate = GetLinkDataRate(child);
+  link.delay = GetLinkDelay(child);
+  return link;
+}
+
+std::vector<PointToPointTreeHelper::Link> PointToPointTreeHelper::GetLinks(){
+  std::vector<Link> links;
+  links.reserve(m_upAddress.size());
+  for(uint32_t child=1; child<m_upAddress.size(); child++){
+    links.push_back(GetLink(child));
+  }
+  return links;
+}
+
+static void
+PrintAddress(FILE* file, Ipv4Address address)
+{
+  uint32_t a = address.Get();
+  std::fprintf(file, "%u.%u.%u.%u", a>>24, (a>>16)&0xff, (a>>8)&0xff, a&0xff);
+}
+
+void PointToPointTreeHelper::ExportTopology(std::string path, TopologyFormat format){
+  NS_ABORT_MSG_IF(m_upAddress.empty(), "PointToPointTreeHelper >> export the topology after AssignIpv4Addresses");
+  FILE* file = std::fopen(path.c_str(), format==TOPOLOGY_BINARY ? "wb" : "w");
+  NS_ABORT_MSG_IF(!file, "PointToPointTreeHelper >> cannot open "<<path);
+  std::vector<char> buffer(1<<20);
+  std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+  if(format==TOPOLOGY_CSV){
+    std::fprintf(file, "fromN fromA toN toA bandwidth delay\n");
+  }
+  else if(format==TOPOLOGY_JSON){
+    std::fprintf(file, "[");
+  }
+  else{
+    uint32_t recordSize = sizeof(LinkRecord);
+    std::fwrite(TOPOLOGY_MAGIC, 1, sizeof(TOPOLOGY_MAGIC), file);
+    std::fwrite(&recordSize, sizeof(recordSize), 1, file);
+  }
+  for(uint32_t child=1; child<m_upAddress.size(); child++){
+    Link link = GetLink(child);
+    unsigned long long bitRate = link.dataRate.GetBitRate();
+    long long delay = link.delay.GetNanoSeconds();
+    switch(format){
+      case TOPOLOGY_CSV:
+        std::fprintf(file, "%u ", link.parent);
+        PrintAddress(file, link.parentAddress);
+        std::fprintf(file, " %u ", link.child);
+        PrintAddress(file, link.childAddress);
+        std::fprintf(file, " %llu %lld\n", bitRate, delay);
+        break;
+      case TOPOLOGY_JSON:
+        std::fprintf(file, "%s\n{\"From\":%u,\"FromAddress\":\"", child==1 ? "" : ",", link.parent);
+        PrintAddress(file, link.parentAddress);
+        std::fprintf(file, "\",\"To\":%u,\"ToAddress\":\"", link.child);
+        PrintAddress(file, link.childAddress);
+        std::fprintf(file, "\",\"Bandwidth\":%llu,\"Delay\":%lld}", bitRate, delay);
+        break;
+      case TOPOLOGY_BINARY:
+        {
+          LinkRecord record;
+          record.parent = link.parent;
+          record.parentAddress = link.parentAddress.Get();
+          record.child = link.child;
+          record.childAddress = link.childAddress.Get();
+          record.bitRate = bitRate;
+          record.delay = delay;
+          std::fwrite(&record, sizeof(record), 1, file);
+        }
+        break;
+    }
+  }
+  if(format==TOPOLOGY_JSON){
+    std::fprintf(file, "\n]\n");
+  }
+  std::fclose(file);
+}
+
+DataRate PointToPointTreeHelper::GetDataRate(uint32_t nLayer){
+  return DataRate(m_bandwidths[nLayer]);
+}
+
+Time PointToPointTreeHelper::GetDelay(uint32_t nLayer){
+  return Time(m_delays[nLayer]);
+}
+
+void PointToPointTreeHelper::SetLinkAttributes(uint32_t nodeId, std::string bandwidth, std::string delay){
+  NS_ABORT_MSG_IF(nodeId==0, "PointToPointTreeHelper >> the root has no uplink");
+  m_uplink[nodeId] = std::make_pair(bandwidth, delay);
+}
+
+DataRate PointToPointTreeHelper::GetLinkDataRate(uint32_t nodeId){
+  auto uplink = m_uplink.find(nodeId);
+  return uplink!=m_uplink.end() ? DataRate(uplink->second.first) : GetDataRate(GetLayer(nodeId)-1);
+}
+
+Time PointToPointTreeHelper::GetLinkDelay(uint32_t nodeId){
+  auto uplink = m_uplink.find(nodeId);
+  return uplink!=m_uplink.end() ? Time(uplink->second.second) : GetDelay(GetLayer(nodeId)-1);
+}
+
 uint32_t PointToPointTreeHelper::GetNodeId(uint32_t nLayer, uint32_t nGroup, uint32_t nNode){
-  uint32_t nodeId = 0;
-  if(nLayer==0){
-    return nodeId;
-  }
-  uint32_t nodeNumInLayer = 1;
-  for(uint32_t i=0; i<nLayer; i++){
-    nodeNumInLayer *= m_nodeNums[i];
-    nodeId += nodeNumInLayer;
-  }
-  nodeId += nGroup*m_nodeNums[nLayer];
-  nodeId += nNode;
-  return nodeId;
+  return m_offset[nLayer]+m_groupStart[nLayer][nGroup]+nNode;
 }
 
 } // namespace ns3
@@ -19,10 +19,16 @@
 #ifndef MY_TREE_HELPER_H
 #define MY_TREE_HELPER_H
 
+#include <map>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "ns3/data-rate.h"
+#include "ns3/nstime.h"
 #include "ns3/point-to-point-helper.h"
+#include "ns3/csma-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv6-address-helper.h"
 #include "ns3/internet-stack-helper.h"
@@ -57,7 +63,39 @@ private:
 class PointToPointTreeHelper
 {
 public:
-  PointToPointTreeHelper (std::vector<int> nodeNums, std::vector<std::string> bandwidth, std::vector<std::string> delays);
+  /**
+   * How the leaves are connected to their parent.
+   */
+  enum LinkMode
+    {
+      LINK_P2P = 0,          //!< a point-to-point link with a queue disc on both ends
+      LINK_P2P_NO_TC = 1,    //!< a point-to-point link without queue discs
+      LINK_CSMA_SHARED = 2   //!< one shared channel per group, a single interface on the parent
+    };
+
+  /**
+   * \param nSystems the number of MPI ranks the subtrees are spread over (see Partition)
+   */
+  PointToPointTreeHelper (std::vector<int> nodeNums, std::vector<std::string> bandwidth, std::vector<std::string> delays, uint32_t nSystems = 1);
+  /**
+   * \param fanout the number of nodes of each group of each layer, a layer
+   *        with a single entry has that number of nodes in every group
+   */
+  PointToPointTreeHelper (std::vector<std::vector<uint32_t>> fanout, std::vector<std::string> bandwidth, std::vector<std::string> delays, uint32_t nSystems = 1);
+  /**
+   * Read the tree from a topology file:
+   * \verbatim
+     # the nodes of each group of layer 2, i.e. under each node of layer 1
+     fanout 1 4
+     fanout 2 50 10 10 3
+     # bandwidth and delay of the links between layer 0 and 1
+     link 0 40Gbps 10ms
+     link 1 10Gbps 5ms
+     # the uplink of node 7 of layer 2
+     uplink 2 7 100Mbps 20ms
+     \endverbatim
+   */
+  PointToPointTreeHelper (std::string topologyFile, uint32_t nSystems = 1);
   PointToPointTreeHelper();
 
   ~PointToPointTreeHelper ();
@@ -70,41 +108,205 @@ public:
 
   void InstallStack (InternetStackHelper stack);
 
+  /**
+   * Connect the leaves with less state per leaf, before AssignIpv4Addresses.
+   * A shared channel has the bandwidth of the layer for the whole group and
+   * ignores the uplinks set by SetLinkAttributes; it needs the aligned
+   * addresses of AssignIpv4Addresses(network, mask), as a group gets one subnet.
+   */
+  void SetAccessLinkMode(LinkMode mode);
+  /**
+   * Queue discs of the links between nLayer and nLayer+1, before AssignIpv4Addresses.
+   * The default is a PfifoFastQueueDisc of 10000000 packets on both ends.
+   * \param queueDisc type and attributes, e.g. "ns3::CoDelQueueDisc[MaxSize=1000p|Target=5ms]"
+   * \param deviceQueue size of the queues of the devices, short enough for the
+   *        backlog to build up in the queue disc (e.g. "100p")
+   * \param bql limit the bytes in the device queues with DynamicQueueLimits
+   */
+  void SetQueueDisc(uint32_t nLayer, std::string queueDisc, std::string deviceQueue, bool bql);
+  LinkMode GetAccessLinkMode();
+  /**
+   * Write the net devices, queue discs and resident memory of this process.
+   */
+  void ReportMemory(std::ostream& os);
+
   void AssignIpv4Addresses (Ipv4AddressHelper address);
+  /**
+   * Assign a /30 to each link so that every subtree gets an aligned
+   * power-of-two block of the network, i.e. a single prefix
+   * (see PointToPointTreeRoutingHelper).
+   * \param network base of the addresses, aligned to the size of the tree
+   * \param mask the tree must fit in it
+   */
+  void AssignIpv4Addresses (Ipv4Address network, Ipv4Mask mask);
+  bool HasSubtreePrefixes();
+  /**
+   * \return the prefix of the links under a non-root node, including its uplink
+   */
+  Ipv4Address GetSubtreeNetwork(uint32_t nodeId);
+  Ipv4Mask GetSubtreeMask(uint32_t nodeId);
 
   size_t GetNLayers();
   size_t GetNGroups(uint32_t nLayer);
   size_t GetNNodes(uint32_t nLayer, uint32_t nGroup);
+  size_t GetNNodes();
+  size_t GetNLayerNodes(uint32_t nLayer);
 
   uint32_t GetParentId(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t parentLayer);
   uint32_t GetParentId(uint32_t nodeId, uint32_t nUp);
+  /**
+   * \return id of the node whose children are the group, also for an empty group
+   */
+  uint32_t GetGroupParentId(uint32_t nLayer, uint32_t nGroup);
   Ipv4Address GetParentAddress(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t parentLayer);
   Ipv4Address GetParentAddress(uint32_t nodeId, uint32_t nUp);
 
   std::vector<uint32_t> GetChildrenId(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t childLayer);
   std::vector<uint32_t> GetChildrenId(uint32_t nodeId, uint32_t nDown);
+  /**
+   * The descendants of a node in a layer have contiguous ids.
+   * \return [first, last) node ids of the descendants nDown layers below
+   */
+  std::pair<uint32_t, uint32_t> GetChildrenRange(uint32_t nodeId, uint32_t nDown);
   std::vector<Ipv4Address> GetChildrenAddress(uint32_t nLayer, uint32_t nGroup, uint32_t nNode, uint32_t childLayer);
   std::vector<Ipv4Address> GetChildrenAddress(uint32_t nodeId, uint32_t nDown);
 
   std::vector<LinkContainer> GetLinkList();
 
+  /**
+   * A link of the tree, i.e. the uplink of its child.
+   */
+  struct Link
+  {
+    uint32_t parent;
+    Ipv4Address parentAddress;
+    uint32_t child;
+    Ipv4Address childAddress;
+    DataRate dataRate;
+    Time delay;
+  };
+  enum TopologyFormat
+    {
+      TOPOLOGY_CSV = 0,
+      TOPOLOGY_JSON = 1,
+      TOPOLOGY_BINARY = 2
+    };
+  /**
+   * Binary record of a link, addresses in host order.
+   */
+  struct LinkRecord
+  {
+    uint32_t parent;
+    uint32_t parentAddress;
+    uint32_t child;
+    uint32_t childAddress;
+    uint64_t bitRate;   //!< [bps]
+    int64_t delay;      //!< [ns]
+  };
+  static const char TOPOLOGY_MAGIC[8];
+
+  /**
+   * \return the uplink of a non-root node, after AssignIpv4Addresses
+   */
+  Link GetLink(uint32_t child);
+  /**
+   * \return the links by the node id of their child, after AssignIpv4Addresses
+   */
+  std::vector<Link> GetLinks();
+  /**
+   * Write the links to a file, after AssignIpv4Addresses.
+   * CSV has the columns of the former myNodeList.csv, then the bandwidth [bps]
+   * and the delay [ns]. A binary file is the 8 byte magic "MYTOPO1", a uint32
+   * record size, then a LinkRecord per link.
+   */
+  void ExportTopology(std::string path, TopologyFormat format);
+
+  /**
+   * \param nLayer upper layer of the links
+   * \return bandwidth of the links between nLayer and nLayer+1
+   */
+  DataRate GetDataRate(uint32_t nLayer);
+  Time GetDelay(uint32_t nLayer);
+  /**
+   * Override the uplink of a node, before AssignIpv4Addresses.
+   */
+  void SetLinkAttributes(uint32_t nodeId, std::string bandwidth, std::string delay);
+  /**
+   * \return bandwidth of the uplink of a node
+   */
+  DataRate GetLinkDataRate(uint32_t nodeId);
+  Time GetLinkDelay(uint32_t nodeId);
+
   uint32_t GetNodeId(uint32_t nLayer, uint32_t nGroup, uint32_t nNode);
+  uint32_t GetLayer(uint32_t nodeId);
+
+  /**
+   * For the distributed simulator, the subtrees below the partition layer are
+   * spread over the systems with about the same number of leaves each and the
+   * nodes above it run on system 0. The partition layer is the one whose
+   * uplinks have the largest delay, which is the lookahead of the ranks.
+   */
+  uint32_t GetNSystems();
+  uint32_t GetPartitionLayer();
+  uint32_t GetSystemId(uint32_t nodeId);
+  /**
+   * \return whether the node runs on this rank, always true without MPI
+   */
+  bool IsLocal(uint32_t nodeId);
 
   template < class T > ApplicationContainer InstallApp(T& app, uint32_t nLayer);
   template < class T > ApplicationContainer InstallApp(T& app, uint32_t nLayer, uint32_t nGroup, uint32_t nNode);
 
 private:
-  std::vector<int> m_nodeNums;
+  void Create(std::vector<std::vector<uint32_t>> fanout, uint32_t nSystems);
+  std::vector<uint32_t> Partition(uint32_t nSystems);
+  PointToPointHelper GetLinkHelper(uint32_t nLayer);
+  Ipv4InterfaceContainer InstallLink(PointToPointHelper& p2p, uint32_t parent, uint32_t child, Ipv4AddressHelper& address);
+  void AssignSubtree(uint32_t nodeId, std::vector<PointToPointHelper>& p2p);
+  void InstallGroup(uint32_t parent, Ipv4AddressHelper& address);
+  std::string GetDeviceQueueSize(uint32_t nLayer);
+  void InstallQueueDisc(uint32_t nLayer, NetDeviceContainer devices);
+  bool IsAccessLink(uint32_t child);
+
+  std::vector<int> m_nodeNums;   //!< the largest group of each layer
   std::vector<std::string> m_bandwidths;
   std::vector<std::string> m_delays;
   std::vector<LinkContainer> m_link;
+
+  std::map<uint32_t, std::pair<std::string, std::string>> m_uplink; //!< bandwidth and delay by node id
+
+  // precomputed index, node ids are contiguous per layer and groups are contiguous in a layer
+  std::vector<uint32_t> m_offset;   //!< id of the first node of each layer, and the number of nodes
+  std::vector<std::vector<uint32_t>> m_groupStart;  //!< index of the first node of each group in its layer, and the number of nodes
+
+  struct QueueDiscConfig
+  {
+    std::string type;
+    std::vector<std::pair<std::string, std::string>> attributes;
+    std::string deviceQueue;
+    bool bql;
+  };
+  std::map<uint32_t, QueueDiscConfig> m_queueDisc;  //!< by upper layer of the links
+
+  LinkMode m_accessMode;
+  uint32_t m_nSystems;
+  uint32_t m_partitionLayer;
+  // addresses of the link to the parent, by node id, set by AssignIpv4Addresses
+  std::vector<Ipv4Address> m_upAddress;    //!< of the node itself
+  std::vector<Ipv4Address> m_downAddress;  //!< of the parent
+  // aligned address blocks, in /30 networks
+  Ipv4Address m_network;
+  std::vector<uint32_t> m_blockBits;  //!< log2 of the block of a subtree in each layer
+  std::vector<uint32_t> m_blockBase;  //!< block of each node, by node id
 };
 
 template < class T > ApplicationContainer PointToPointTreeHelper::InstallApp(T& app, uint32_t nLayer){
   ApplicationContainer appCon;
   for(size_t i=0;i<GetNGroups(nLayer);i++){
     for(size_t j=0;j<GetNNodes(nLayer,i);j++){
-      appCon.Add(app.Install(GetNode(nLayer,i,j)));
+      if(IsLocal(GetNodeId(nLayer,i,j))){
+        appCon.Add(app.Install(GetNode(nLayer,i,j)));
+      }
     }
   }
   return appCon;
@@ -1,55 +1,619 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
-// Include a header file from your module to test.
-#include "ns3/fog.h"
+#include "ns3/json.h"
+#include "ns3/my-message.h"
+#include "ns3/my-metrics.h"
+#include "ns3/my-onoff-application-helper.h"
+#include "ns3/my-queueing.h"
+#include "ns3/my-result-cache.h"
+#include "ns3/my-tcp-server.h"
+#include "ns3/my-tcp-server-helper.h"
+#include "ns3/my-trace-replayer.h"
+#include "ns3/my-tree.h"
 
-// An essential include is test.h
+#include "ns3/boolean.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/uinteger.h"
 #include "ns3/test.h"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
 
-// This is an example TestCase.
-class FogTestCase1 : public TestCase
+// Erlang-B/C and M/M/c waits against exact values computed with rationals.
+class MyQueueingTestCase : public TestCase
+{
+public:
+  MyQueueingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MyQueueingTestCase::MyQueueingTestCase ()
+  : TestCase ("Erlang-B/C and M/M/c against reference values")
+{
+}
+
+void
+MyQueueingTestCase::DoRun (void)
+{
+  struct Reference { double a; uint32_t c; double erlangB; double erlangC; };
+  const Reference refs[] = {
+    { 2, 3, 0.210526315789474, 0.444444444444444 },
+    { 10, 13, 0.0843388626723665, 0.285270453036493 },
+    { 15, 20, 0.0455932155898118, 0.160429387416924 },
+    { 1900, 2000, 0.000678969296498602, 0.0134064373031903 },
+    { 4500, 5000, 1.29183180785281e-14, 1.29183180785266e-13 },
+    { 25, 20, 0.279890150989705, 1 },
+  };
+  for(const Reference& r : refs){
+    NS_TEST_ASSERT_MSG_EQ_TOL (MyQueueing::ErlangB(r.a, r.c), r.erlangB, r.erlangB*1e-9,
+                               "ErlangB(" << r.a << "," << r.c << ")");
+    NS_TEST_ASSERT_MSG_EQ_TOL (MyQueueing::ErlangC(r.a, r.c), r.erlangC, r.erlangC*1e-9,
+                               "ErlangC(" << r.a << "," << r.c << ")");
+  }
+
+  NS_TEST_ASSERT_MSG_EQ_TOL (MyQueueing::MmcWait(15, 1, 20), 0.0320858774833847, 1e-12, "MmcWait");
+  NS_TEST_ASSERT_MSG_EQ (MyQueueing::ErlangC(20, 20), 1, "a == c must wait");
+  NS_TEST_ASSERT_MSG_EQ (std::isinf(MyQueueing::MmcWait(20, 1, 20)), true, "a == c is unstable");
+  NS_TEST_ASSERT_MSG_EQ (std::isinf(MyQueueing::MmcWait(25, 1, 20)), true, "a > c is unstable");
+
+  // the batch runs the recurrence in lockstep, so mix c between queues
+  std::vector<double> lambda = { 2, 20, 15, 1900, 25, 0.5, 4500, 10 };
+  std::vector<double> mu = { 1, 2, 1, 1, 1, 1, 1, 1 };
+  std::vector<uint32_t> c = { 3, 13, 20, 2000, 20, 1, 5000, 13 };
+  std::vector<double> a, wait, erlang;
+  for(uint32_t i = 0; i < lambda.size(); i++) a.push_back(lambda[i]/mu[i]);
+  MyQueueing::MmcWait(lambda, mu, c, wait);
+  MyQueueing::ErlangC(a, c, erlang);
+  NS_TEST_ASSERT_MSG_EQ (wait.size(), lambda.size(), "one wait per queue");
+  NS_TEST_ASSERT_MSG_EQ (erlang.size(), a.size(), "one probability per queue");
+  for(uint32_t i = 0; i < lambda.size(); i++){
+    double w = MyQueueing::MmcWait(lambda[i], mu[i], c[i]);
+    if(std::isinf(w)){
+      NS_TEST_ASSERT_MSG_EQ (std::isinf(wait[i]), true, "batch wait of queue " << i);
+    }else{
+      NS_TEST_ASSERT_MSG_EQ_TOL (wait[i], w, w*1e-12 + 1e-300, "batch wait of queue " << i);
+    }
+    double e = MyQueueing::ErlangC(a[i], c[i]);
+    NS_TEST_ASSERT_MSG_EQ_TOL (erlang[i], e, e*1e-12 + 1e-300, "batch ErlangC of queue " << i);
+  }
+}
+
+// Eviction order of both policies, expiry and capacity changes.
+class MyResultCacheTestCase : public TestCase
+{
+public:
+  MyResultCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void CheckLookup (MyResultCache* cache, uint64_t key, bool expected);
+};
+
+MyResultCacheTestCase::MyResultCacheTestCase ()
+  : TestCase ("MyResultCache eviction, TTL and capacity")
+{
+}
+
+void
+MyResultCacheTestCase::CheckLookup (MyResultCache* cache, uint64_t key, bool expected)
+{
+  NS_TEST_EXPECT_MSG_EQ (cache->Lookup(key), expected,
+                         "lookup of key " << key << " at " << Simulator::Now().GetSeconds() << "s");
+}
+
+void
+MyResultCacheTestCase::DoRun (void)
+{
+  // LRU evicts the least recently used key, lookups refresh it
+  MyResultCache lru;
+  lru.SetCapacity(3);
+  lru.Insert(1);
+  lru.Insert(2);
+  lru.Insert(3);
+  NS_TEST_ASSERT_MSG_EQ (lru.Lookup(1), true, "1 is cached");
+  lru.Insert(4);
+  NS_TEST_ASSERT_MSG_EQ (lru.GetSize(), 3, "LRU is bounded by its capacity");
+  NS_TEST_ASSERT_MSG_EQ (lru.Lookup(2), false, "LRU evicts 2, the least recently used");
+  NS_TEST_ASSERT_MSG_EQ (lru.Lookup(1), true, "LRU keeps 1");
+  NS_TEST_ASSERT_MSG_EQ (lru.Lookup(3), true, "LRU keeps 3");
+  NS_TEST_ASSERT_MSG_EQ (lru.Lookup(4), true, "LRU keeps 4");
+  lru.Insert(5);
+  NS_TEST_ASSERT_MSG_EQ (lru.Lookup(1), false, "LRU evicts 1, now the least recently used");
+  NS_TEST_ASSERT_MSG_EQ (lru.GetNHits(), 4, "LRU hits");
+  NS_TEST_ASSERT_MSG_EQ (lru.GetNMisses(), 2, "LRU misses");
+
+  // LFU evicts the least frequently used key, the oldest one on ties
+  MyResultCache lfu;
+  lfu.SetPolicy(MyResultCache::LFU);
+  lfu.SetCapacity(3);
+  lfu.Insert(1);
+  lfu.Insert(2);
+  lfu.Insert(3);
+  lfu.Lookup(1);
+  lfu.Lookup(1);
+  lfu.Lookup(3);
+  lfu.Insert(4);
+  NS_TEST_ASSERT_MSG_EQ (lfu.Lookup(2), false, "LFU evicts 2, used once");
+  lfu.Insert(5);
+  NS_TEST_ASSERT_MSG_EQ (lfu.Lookup(4), false, "LFU evicts 4, used once and older than 5");
+  NS_TEST_ASSERT_MSG_EQ (lfu.Lookup(1), true, "LFU keeps 1");
+  NS_TEST_ASSERT_MSG_EQ (lfu.Lookup(3), true, "LFU keeps 3");
+  NS_TEST_ASSERT_MSG_EQ (lfu.Lookup(5), true, "LFU keeps 5");
+
+  // shrinking evicts in policy order, zero capacity disables the cache
+  MyResultCache shrink;
+  shrink.SetCapacity(4);
+  for(uint64_t key = 1; key <= 4; key++) shrink.Insert(key);
+  shrink.Lookup(2);
+  shrink.SetCapacity(2);
+  NS_TEST_ASSERT_MSG_EQ (shrink.GetSize(), 2, "shrink evicts down to the capacity");
+  NS_TEST_ASSERT_MSG_EQ (shrink.Lookup(1), false, "shrink evicts 1");
+  NS_TEST_ASSERT_MSG_EQ (shrink.Lookup(3), false, "shrink evicts 3");
+  NS_TEST_ASSERT_MSG_EQ (shrink.Lookup(2), true, "shrink keeps 2");
+  NS_TEST_ASSERT_MSG_EQ (shrink.Lookup(4), true, "shrink keeps 4");
+  shrink.SetCapacity(0);
+  shrink.Insert(5);
+  NS_TEST_ASSERT_MSG_EQ (shrink.GetSize(), 0, "zero capacity caches nothing");
+
+  // entries expire TTL after their last insert, lookups do not refresh them
+  MyResultCache ttl;
+  ttl.SetCapacity(4);
+  ttl.SetTtl(Seconds(10));
+  ttl.Insert(1);
+  ttl.Insert(2);
+  Simulator::Schedule(Seconds(5), &MyResultCache::Insert, &ttl, 2);
+  Simulator::Schedule(Seconds(9), &MyResultCacheTestCase::CheckLookup, this, &ttl, 1, true);
+  Simulator::Schedule(Seconds(10), &MyResultCacheTestCase::CheckLookup, this, &ttl, 1, false);
+  Simulator::Schedule(Seconds(14), &MyResultCacheTestCase::CheckLookup, this, &ttl, 2, true);
+  Simulator::Schedule(Seconds(15), &MyResultCacheTestCase::CheckLookup, this, &ttl, 2, false);
+  Simulator::Run();
+  Simulator::Destroy();
+  NS_TEST_ASSERT_MSG_EQ (ttl.GetSize(), 0, "expired entries are removed on lookup");
+}
+
+// Framing of messages on a TCP stream.
+class MyMessageTestCase : public TestCase
+{
+public:
+  MyMessageTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MyMessageTestCase::MyMessageTestCase ()
+  : TestCase ("MyMessage framing")
+{
+}
+
+void
+MyMessageTestCase::DoRun (void)
+{
+  // the text is read up to its size, not up to the padding
+  std::string text = "{\"Id\": \"42\", \"Total\": 3}";
+  Ptr<Packet> frame = MyMessage::CreateFrame(text, 1000);
+  NS_TEST_ASSERT_MSG_EQ (frame->GetSize(), 1000, "the frame is padded to the requested size");
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetText(frame), text, "GetText ignores the padding");
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::Parse(frame)["Total"].int_value(), 3, "Parse ignores the padding");
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetRequestId(MyMessage::Parse(frame)), 42, "request id");
+
+  // a text longer than the requested size is not truncated
+  std::string longText(100, 'x');
+  frame = MyMessage::CreateFrame(longText, 10);
+  NS_TEST_ASSERT_MSG_EQ (frame->GetSize(), MyMessage::HEADER_SIZE+longText.size(), "the frame grows to hold the text");
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetText(frame), longText, "the whole text is kept");
+  frame = MyMessage::CreateFrame(std::string());
+  NS_TEST_ASSERT_MSG_EQ (frame->GetSize(), MyMessage::HEADER_SIZE, "an empty text is a bare header");
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetText(frame), std::string(), "empty text");
+
+  uint64_t id = (static_cast<uint64_t>(0x0a010203)<<32) | 7;
+  json11::Json request = json11::Json::object {{"Id", MyMessage::FormatRequestId(id)}};
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetRequestId(request), id, "request ids keep all 64 bits");
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetRequestId(json11::Json::object {}), 0, "no request id");
+
+  // the ids read without parsing match the parsed ones, for an aggregate too
+  json11::Json member = json11::Json::object {{"Id", MyMessage::FormatRequestId(id+1)}, {"ActuatorId", "x"}};
+  json11::Json aggregate = json11::Json::object {{"NodeId", "n"}, {"Members", json11::Json::array {request, member}}};
+  std::vector<uint64_t> ids = MyMessage::GetRequestIds(MyMessage::CreateFrame(aggregate.dump(), 100));
+  NS_TEST_ASSERT_MSG_EQ (ids.size(), 2, "one id per member");
+  NS_TEST_ASSERT_MSG_EQ (ids[0], id, "first member");
+  NS_TEST_ASSERT_MSG_EQ (ids[1], id+1, "second member");
+  json11::Json quoted = json11::Json::object {{"Key", "\"Id\": \"5\""}};
+  NS_TEST_ASSERT_MSG_EQ (MyMessage::GetRequestIds(MyMessage::CreateFrame(quoted.dump())).size(), 0, "a quoted key in a value is no id");
+
+  // several frames in one buffer, and frames split across segments
+  std::vector<std::string> texts = { "first", std::string(300, 'y'), "", "last" };
+  std::vector<uint32_t> sizes = { 0, 50, 64, 2000 };
+  Ptr<Packet> stream = Create<Packet>();
+  for(uint32_t i = 0; i < texts.size(); i++){
+    stream->AddAtEnd(MyMessage::CreateFrame(texts[i], sizes[i]));
+  }
+  for(uint32_t segment : { 1u, 3u, 7u, 536u, stream->GetSize() }){
+    Ptr<Packet> buffer = Create<Packet>();
+    std::vector<std::string> received;
+    for(uint32_t offset = 0; offset < stream->GetSize(); offset += segment){
+      buffer->AddAtEnd(stream->CreateFragment(offset, std::min(segment, stream->GetSize()-offset)));
+      Ptr<Packet> popped;
+      while(MyMessage::Pop(buffer, popped)){
+        received.push_back(MyMessage::GetText(popped));
+      }
+    }
+    NS_TEST_ASSERT_MSG_EQ (buffer->GetSize(), 0, "segments of " << segment << " bytes leave no bytes behind");
+    NS_TEST_ASSERT_MSG_EQ (received.size(), texts.size(), "segments of " << segment << " bytes");
+    for(uint32_t i = 0; i < received.size(); i++){
+      NS_TEST_ASSERT_MSG_EQ (received[i], texts[i], "frame " << i << " in segments of " << segment << " bytes");
+    }
+  }
+}
+
+// Aligned subtree prefixes of an irregular tree.
+class MyTreeAddressTestCase : public TestCase
+{
+public:
+  MyTreeAddressTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MyTreeAddressTestCase::MyTreeAddressTestCase ()
+  : TestCase ("PointToPointTreeHelper subtree prefixes")
+{
+}
+
+void
+MyTreeAddressTestCase::DoRun (void)
+{
+  // groups of different sizes, including an empty one
+  std::vector<std::vector<uint32_t>> fanout = { { 1 }, { 3 }, { 2, 1, 4 }, { 1, 3, 0, 2, 1, 2, 5 } };
+  PointToPointTreeHelper tree(fanout, { "10Gbps", "1Gbps", "100Mbps" }, { "10ms", "5ms", "2ms" });
+  InternetStackHelper internet;
+  tree.InstallStack(internet);
+  Ipv4Address network("10.1.0.0");
+  Ipv4Mask mask("255.255.0.0");
+  tree.AssignIpv4Addresses(network, mask);
+  NS_TEST_ASSERT_MSG_EQ (tree.HasSubtreePrefixes(), true, "aligned addresses give subtree prefixes");
+
+  uint32_t nNodes = tree.GetNNodes();
+  std::set<uint32_t> addresses;
+  for(uint32_t nodeId = 1; nodeId < nNodes; nodeId++){
+    Ipv4Address up = tree.GetIpv4Address(nodeId, 1);
+    Ipv4Address down = tree.GetParentAddress(nodeId, 1);
+    NS_TEST_ASSERT_MSG_EQ (mask.IsMatch(up, network), true, "node " << nodeId << " is in the network");
+    NS_TEST_ASSERT_MSG_EQ (addresses.insert(up.Get()).second, true, "address of node " << nodeId << " is unique");
+    NS_TEST_ASSERT_MSG_EQ (addresses.insert(down.Get()).second, true, "parent address of node " << nodeId << " is unique");
+  }
+
+  for(uint32_t nodeId = 1; nodeId < nNodes; nodeId++){
+    Ipv4Address prefix = tree.GetSubtreeNetwork(nodeId);
+    Ipv4Mask prefixMask = tree.GetSubtreeMask(nodeId);
+    NS_TEST_ASSERT_MSG_EQ (prefix.CombineMask(prefixMask), prefix, "block of node " << nodeId << " is aligned");
+    // the uplinks of the node and of all its descendants, on both ends
+    uint32_t nLayer = tree.GetLayer(nodeId);
+    for(uint32_t nDown = 0; nLayer+nDown < tree.GetNLayers(); nDown++){
+      for(uint32_t child : tree.GetChildrenId(nodeId, nDown)){
+        NS_TEST_ASSERT_MSG_EQ (prefixMask.IsMatch(tree.GetIpv4Address(child, 1), prefix), true,
+                               "node " << child << " is in the block of node " << nodeId);
+        NS_TEST_ASSERT_MSG_EQ (prefixMask.IsMatch(tree.GetParentAddress(child, 1), prefix), true,
+                               "parent of node " << child << " is in the block of node " << nodeId);
+      }
+    }
+    // blocks only overlap when one subtree holds the other
+    uint64_t first = prefix.Get();
+    uint64_t last = first+(~prefixMask.Get())+1ULL;
+    for(uint32_t other = 1; other < nNodes; other++){
+      uint32_t otherLayer = tree.GetLayer(other);
+      if(other==nodeId || otherLayer<nLayer || (otherLayer==nLayer && other<nodeId)){
+        continue;
+      }
+      uint64_t otherFirst = tree.GetSubtreeNetwork(other).Get();
+      uint64_t otherLast = otherFirst+(~tree.GetSubtreeMask(other).Get())+1ULL;
+      bool overlap = first<otherLast && otherFirst<last;
+      bool descendant = tree.GetParentId(other, otherLayer-nLayer)==nodeId;
+      NS_TEST_ASSERT_MSG_EQ (overlap, descendant, "blocks of nodes " << nodeId << " and " << other);
+    }
+  }
+  Simulator::Destroy();
+}
+
+// Relative error of the log-linear latency buckets.
+class MyLatencyHistogramTestCase : public TestCase
+{
+public:
+  MyLatencyHistogramTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MyLatencyHistogramTestCase::MyLatencyHistogramTestCase ()
+  : TestCase ("MyLatencyHistogram relative error")
+{
+}
+
+static double
+RelativeError(uint64_t value, uint64_t exact)
+{
+  return std::fabs(static_cast<double>(value)-static_cast<double>(exact))/std::max<uint64_t>(exact, 1);
+}
+
+void
+MyLatencyHistogramTestCase::DoRun (void)
+{
+  for(uint32_t bits : { 4u, 8u, 12u }){
+    MyLatencyHistogram histogram(bits);
+    double bound = std::ldexp(1.0, -static_cast<int>(bits-1));
+
+    // small values are exact, the others keep bits-1 significant bits
+    std::vector<uint64_t> values;
+    for(uint64_t v = 0; v < (1ULL<<(bits+4)); v++) values.push_back(v);
+    for(uint32_t msb = bits; msb < 63; msb++){
+      values.push_back((1ULL<<msb)-1);
+      values.push_back(1ULL<<msb);
+      values.push_back((1ULL<<msb)+1);
+      values.push_back((3ULL<<(msb-1))+7);
+    }
+    uint32_t lastIndex = 0;
+    uint64_t lastValue = 0;
+    for(uint64_t v : values){
+      uint32_t index = histogram.GetIndex(v);
+      if(v < (1ULL<<bits)){
+        NS_TEST_ASSERT_MSG_EQ (histogram.GetValue(index), v, "value " << v << " is exact with " << bits << " bits");
+      }
+      NS_TEST_ASSERT_MSG_LT (RelativeError(histogram.GetValue(index), v), bound,
+                             "value " << v << " with " << bits << " bits");
+      if(v > lastValue){
+        NS_TEST_ASSERT_MSG_EQ (index >= lastIndex, true, "buckets grow with the value " << v);
+      }
+      lastIndex = index;
+      lastValue = v;
+    }
+
+    // percentiles of a heavy tailed sample against the exact order statistics
+    std::mt19937_64 rng(bits);
+    std::lognormal_distribution<double> latency(std::log(5e6), 1.5);
+    std::vector<uint64_t> sample;
+    for(uint32_t i = 0; i < 20000; i++){
+      uint64_t ns = latency(rng);
+      sample.push_back(ns);
+      histogram.Record(NanoSeconds(ns));
+    }
+    std::sort(sample.begin(), sample.end());
+    NS_TEST_ASSERT_MSG_EQ (histogram.GetCount(), sample.size(), "every value is counted");
+    NS_TEST_ASSERT_MSG_EQ (histogram.GetMax().GetNanoSeconds(), static_cast<int64_t>(sample.back()), "the max is exact");
+    for(double p : { 0.0, 1.0, 10.0, 50.0, 90.0, 99.0, 99.9, 100.0 }){
+      uint64_t rank = std::max<uint64_t>(1, std::ceil(p/100.0*sample.size()));
+      uint64_t exact = sample[rank-1];
+      uint64_t estimate = histogram.GetPercentile(p).GetNanoSeconds();
+      NS_TEST_ASSERT_MSG_LT (RelativeError(estimate, exact), bound,
+                             "percentile " << p << " with " << bits << " bits");
+    }
+  }
+}
+
+// Offloading to a peer whose load never changed.
+class MyTcpServerOffloadTestCase : public TestCase
 {
 public:
-  FogTestCase1 ();
-  virtual ~FogTestCase1 ();
+  MyTcpServerOffloadTestCase ();
 
 private:
   virtual void DoRun (void);
+  void SendRequests (Ptr<Socket> socket, uint32_t n);
+  void Offloaded (Ptr<const Packet> packet);
+
+  uint32_t m_nSent;
+  uint32_t m_nOffloaded;
 };
 
-// Add some help text to this case to describe what it is intended to test
-FogTestCase1::FogTestCase1 ()
-  : TestCase ("Fog test case (does nothing)")
+MyTcpServerOffloadTestCase::MyTcpServerOffloadTestCase ()
+  : TestCase ("MyTcpServer offloads to an idle peer"),
+    m_nSent(0),
+    m_nOffloaded(0)
 {
 }
 
-// This destructor does nothing but we include it as a reminder that
-// the test case should clean up after itself
-FogTestCase1::~FogTestCase1 ()
+void
+MyTcpServerOffloadTestCase::SendRequests (Ptr<Socket> socket, uint32_t n)
 {
+  json11::Json::object client = {{"Address", "10.1.1.1"}, {"Port", 7000}};
+  for(uint32_t i = 0; i < n; i++){
+    json11::Json request = json11::Json::object {
+      {"NodeId", client},
+      {"ActuatorId", client},
+      {"Id", MyMessage::FormatRequestId(++m_nSent)},
+    };
+    socket->Send(MyMessage::CreateFrame(request.dump(), 1000));
+  }
 }
 
-//
-// This method is the pure virtual method from class TestCase that every
-// TestCase must implement
-//
 void
-FogTestCase1::DoRun (void)
+MyTcpServerOffloadTestCase::Offloaded (Ptr<const Packet> packet)
 {
-  // A wide variety of test macros are available in src/core/test.h
-  NS_TEST_ASSERT_MSG_EQ (true, true, "true doesn't equal true for some reason");
-  // Use this one for floating point comparisons
-  NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
+  m_nOffloaded++;
+}
+
+void
+MyTcpServerOffloadTestCase::DoRun (void)
+{
+  // client 0 -- server 1 -- idle peer 2
+  NodeContainer nodes;
+  nodes.Create(3);
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute("DataRate", StringValue("1Gbps"));
+  p2p.SetChannelAttribute("Delay", StringValue("1ms"));
+  NetDeviceContainer clientLink = p2p.Install(nodes.Get(0), nodes.Get(1));
+  NetDeviceContainer peerLink = p2p.Install(nodes.Get(1), nodes.Get(2));
+  InternetStackHelper internet;
+  internet.Install(nodes);
+  Ipv4AddressHelper address("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer clientAddress = address.Assign(clientLink);
+  address.SetBase("10.1.2.0", "255.255.255.0");
+  Ipv4InterfaceContainer peerAddress = address.Assign(peerLink);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+
+  // jobs of 100ms, from the second waiting job on a job goes to a peer with two jobs less
+  MyTcpServerHelper serverHelper("ns3::TcpSocketFactory", 100000, InetSocketAddress(Ipv4Address::GetAny(), 8000));
+  serverHelper.SetAttribute("CalcTime", StringValue("ns3::ConstantRandomVariable[Constant=100000]"));
+  serverHelper.SetAttribute("LoadPort", UintegerValue(9000));
+  serverHelper.SetAttribute("OffloadThreshold", UintegerValue(2));
+  Ptr<MyTcpServer> server = DynamicCast<MyTcpServer>(serverHelper.Install(nodes.Get(1)).Get(0));
+  Ptr<MyTcpServer> peer = DynamicCast<MyTcpServer>(serverHelper.Install(nodes.Get(2)).Get(0));
+  Ipv4Address serverIp = peerAddress.GetAddress(0);
+  Ipv4Address peerIp = peerAddress.GetAddress(1);
+  server->AddPeer(2, InetSocketAddress(peerIp, 8000), InetSocketAddress(peerIp, 9000), 1);
+  peer->AddPeer(1, InetSocketAddress(serverIp, 8000), InetSocketAddress(serverIp, 9000), 1);
+  server->TraceConnectWithoutContext("Offload", MakeCallback(&MyTcpServerOffloadTestCase::Offloaded, this));
+  server->SetStartTime(Seconds(0));
+  peer->SetStartTime(Seconds(0));
+  server->SetStopTime(Seconds(4));
+  peer->SetStopTime(Seconds(4));
+
+  Ptr<Socket> client = Socket::CreateSocket(nodes.Get(0), TcpSocketFactory::GetTypeId());
+  client->Bind();
+  client->Connect(InetSocketAddress(clientAddress.GetAddress(1), 8000));
+  // the peer stays idle, so its reports never change; the second burst
+  // comes after the estimate of the first offloaded job has been corrected
+  Simulator::Schedule(Seconds(1), &MyTcpServerOffloadTestCase::SendRequests, this, client, 4);
+  Simulator::Schedule(Seconds(2), &MyTcpServerOffloadTestCase::SendRequests, this, client, 4);
+  Simulator::Stop(Seconds(5));
+  Simulator::Run();
+
+  NS_TEST_ASSERT_MSG_EQ (m_nOffloaded, 2, "one job of each burst goes to the idle peer");
+  NS_TEST_ASSERT_MSG_EQ (peer->GetNRequests(), 2, "the peer received the offloaded jobs");
+  NS_TEST_ASSERT_MSG_EQ (server->GetNRequests(), 8, "the server received every request");
+  Simulator::Destroy();
+}
+
+// The mean rate of an open-loop client for the off time distributions.
+class MyOnOffMeanRateTestCase : public TestCase
+{
+public:
+  MyOnOffMeanRateTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MyOnOffMeanRateTestCase::MyOnOffMeanRateTestCase ()
+  : TestCase ("MyOnOffApplication mean rate of the off times")
+{
+}
+
+void
+MyOnOffMeanRateTestCase::DoRun (void)
+{
+  // off times [us] of mean 1000, so 1000 requests per second
+  std::vector<std::string> offTimes = {
+    "ns3::ExponentialRandomVariable[Mean=1000]",
+    "ns3::ConstantRandomVariable[Constant=1000]",
+    "ns3::UniformRandomVariable[Min=500|Max=1500]",
+    "ns3::ParetoRandomVariable[Mean=1000|Shape=1.5]",
+    "ns3::NormalRandomVariable[Mean=1000|Variance=100]",
+    "ns3::GammaRandomVariable[Alpha=4|Beta=250]",
+    "ns3::ErlangRandomVariable[K=4|Lambda=250]",
+    "ns3::WeibullRandomVariable[Scale=1000|Shape=1]",
+    "ns3::TriangularRandomVariable[Mean=1000|Min=0|Max=2000]",
+  };
+  for(auto& offTime: offTimes){
+    Ptr<MyOnOffApplication> client = CreateObject<MyOnOffApplication>();
+    client->SetAttribute("OffTime", StringValue(offTime));
+    NS_TEST_ASSERT_MSG_EQ_TOL (client->GetMeanRate(), 1000, 1e-6, offTime);
+  }
+  Ptr<MyOnOffApplication> client = CreateObject<MyOnOffApplication>();
+  client->SetAttribute("OffTime", StringValue("ns3::LogNormalRandomVariable[Mu=6|Sigma=1]"));
+  NS_TEST_ASSERT_MSG_EQ_TOL (client->GetMeanRate(), 1000000/std::exp(6.5), 1e-6, "log-normal off time");
+  client->SetAttribute("Outstanding", UintegerValue(1));
+  NS_TEST_ASSERT_MSG_EQ (client->GetMeanRate(), 0, "a closed loop has no rate of its own");
+}
+
+// Rows due before the connection of the client are sent once it is up.
+class MyTraceReplayerTestCase : public TestCase
+{
+public:
+  MyTraceReplayerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MyTraceReplayerTestCase::MyTraceReplayerTestCase ()
+  : TestCase ("MyTraceReplayer replays a trace through the clients")
+{
+}
+
+void
+MyTraceReplayerTestCase::DoRun (void)
+{
+  std::string path = CreateTempDirFilename("trace.txt");
+  {
+    std::ofstream trace(path);
+    trace << "# time client size key\n"
+          << "0 0 500\n"
+          << "0 0 600 3\n"
+          << "\n"
+          << "500000000 0 700\n"
+          << "600000000 1 700\n"
+          << "3000000000 0 100\n";
+  }
+
+  NodeContainer nodes;
+  nodes.Create(2);
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute("DataRate", StringValue("1Gbps"));
+  p2p.SetChannelAttribute("Delay", StringValue("1ms"));
+  NetDeviceContainer link = p2p.Install(nodes);
+  InternetStackHelper internet;
+  internet.Install(nodes);
+  Ipv4AddressHelper address("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign(link);
+
+  MyTcpServerHelper serverHelper("ns3::TcpSocketFactory", 1000, InetSocketAddress(Ipv4Address::GetAny(), 8000));
+  serverHelper.SetAttribute("CalcTime", StringValue("ns3::ConstantRandomVariable[Constant=1000]"));
+  ApplicationContainer serverApp = serverHelper.Install(nodes.Get(1));
+  Ptr<MyTcpServer> server = DynamicCast<MyTcpServer>(serverApp.Get(0));
+  serverApp.Start(Seconds(0));
+  serverApp.Stop(Seconds(5));
+
+  MyOnOffHelper clientHelper("ns3::TcpSocketFactory", InetSocketAddress(interfaces.GetAddress(1), 8000));
+  clientHelper.SetAttribute("Actuator", AddressValue(InetSocketAddress(interfaces.GetAddress(0), 7000)));
+  clientHelper.SetAttribute("Replay", BooleanValue(true));
+  ApplicationContainer clientApp = clientHelper.Install(nodes.Get(0));
+  clientApp.Start(Seconds(1));
+  clientApp.Stop(Seconds(3));
+
+  // the first two rows are due when the client starts, before its connection
+  Ptr<MyTraceReplayer> replayer = Create<MyTraceReplayer>(path);
+  replayer->AddClient(0, DynamicCast<MyOnOffApplication>(clientApp.Get(0)));
+  replayer->Start(Seconds(1), Seconds(10));
+  Simulator::Stop(Seconds(5));
+  Simulator::Run();
+
+  NS_TEST_ASSERT_MSG_EQ (replayer->GetNReplayed(), 3, "rows of the client before it stopped");
+  NS_TEST_ASSERT_MSG_EQ (replayer->GetNSkipped(), 1, "the row of a client that is not added");
+  NS_TEST_ASSERT_MSG_EQ (replayer->GetNDropped(), 1, "the row after the client stopped");
+  NS_TEST_ASSERT_MSG_EQ (server->GetNRequests(), 3, "every replayed row reached the server");
+  Simulator::Destroy();
 }
 
-// The TestSuite class names the TestSuite, identifies what type of TestSuite,
-// and enables the TestCases to be run.  Typically, only the constructor for
-// this class must be defined
-//
 class FogTestSuite : public TestSuite
 {
 public:
@@ -59,10 +623,15 @@ public:
 FogTestSuite::FogTestSuite ()
   : TestSuite ("fog", UNIT)
 {
-  // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
-  AddTestCase (new FogTestCase1, TestCase::QUICK);
+  AddTestCase (new MyQueueingTestCase, TestCase::QUICK);
+  AddTestCase (new MyResultCacheTestCase, TestCase::QUICK);
+  AddTestCase (new MyMessageTestCase, TestCase::QUICK);
+  AddTestCase (new MyTreeAddressTestCase, TestCase::QUICK);
+  AddTestCase (new MyLatencyHistogramTestCase, TestCase::QUICK);
+  AddTestCase (new MyTcpServerOffloadTestCase, TestCase::QUICK);
+  AddTestCase (new MyOnOffMeanRateTestCase, TestCase::QUICK);
+  AddTestCase (new MyTraceReplayerTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
 static FogTestSuite fogTestSuite;
-